@@ -12,6 +12,46 @@
 #include <107-Arduino-littlefs.h>
 #include <107-Arduino-24LCxx.hpp>
 
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Adapts the 24LCxx EEPROM to the block device interface
+ * expected by littlefs::BlockDeviceConfig.
+ */
+class EepromBlockDevice
+{
+private:
+  EEPROM_24LCxx & _eeprom;
+
+public:
+  EepromBlockDevice(EEPROM_24LCxx & eeprom) : _eeprom{eeprom} { }
+
+  /* littlefs demands (erase) block size to exceed read/prog size. */
+  size_t block_size() { return _eeprom.page_size() * 4; }
+
+  int read(lfs_block_t block, lfs_off_t off, void * buffer, lfs_size_t size)
+  {
+    _eeprom.read_page((block * block_size()) + off, (uint8_t *)buffer, size);
+    return LFS_ERR_OK;
+  }
+  int prog(lfs_block_t block, lfs_off_t off, const void * buffer, lfs_size_t size)
+  {
+    _eeprom.write_page((block * block_size()) + off, (uint8_t const *)buffer, size);
+    return LFS_ERR_OK;
+  }
+  int erase(lfs_block_t block)
+  {
+    for(size_t off = 0; off < block_size(); off += _eeprom.page_size())
+      _eeprom.fill_page((block * block_size()) + off, 0xFF);
+    return LFS_ERR_OK;
+  }
+  int sync()
+  {
+    return LFS_ERR_OK;
+  }
+};
+
 /**************************************************************************************
  * GLOBAL CONSTANTS
  **************************************************************************************/
@@ -31,32 +71,15 @@ static EEPROM_24LCxx eeprom(EEPROM_24LCxx_Type::LC64,
                             []() { return Wire.available(); },
                             []() { return Wire.read(); });
 
-static littlefs::FilesystemConfig filesystem_config
+static EepromBlockDevice eeprom_block_device(eeprom);
+
+static littlefs::BlockDeviceConfig<EepromBlockDevice> filesystem_config
   (
-    +[](const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) -> int
-    {
-      eeprom.read_page((block * c->block_size) + off, (uint8_t *)buffer, size);
-      return LFS_ERR_OK;
-    },
-    +[](const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size) -> int
-    {
-      eeprom.write_page((block * c->block_size) + off, (uint8_t const *)buffer, size);
-      return LFS_ERR_OK;
-    },
-    +[](const struct lfs_config *c, lfs_block_t block) -> int
-    {
-      for(size_t off = 0; off < c->block_size; off += eeprom.page_size())
-        eeprom.fill_page((block * c->block_size) + off, 0xFF);
-      return LFS_ERR_OK;
-    },
-    +[](const struct lfs_config *c) -> int
-    {
-      return LFS_ERR_OK;
-    },
+    eeprom_block_device,
     eeprom.page_size(),
     eeprom.page_size(),
-    (eeprom.page_size() * 4), /* littlefs demands (erase) block size to exceed read/prog size. */
-    eeprom.device_size() / (eeprom.page_size() * 4),
+    eeprom_block_device.block_size(),
+    eeprom.device_size() / eeprom_block_device.block_size(),
     500,
     eeprom.page_size(),
     eeprom.page_size()
@@ -146,29 +169,29 @@ void setup()
 
   Serial.println("root folder contents:");
   littlefs::DirHandle const dir_hdl = std::get<littlefs::DirHandle>(rc_dir_open);
-  for(;;)
+  auto rc_dir_entries = filesystem.dir_entries(dir_hdl);
+  if (std::holds_alternative<littlefs::Error>(rc_dir_entries))
   {
-    std::string name;
-    littlefs::Type type;
-    auto const rc_dir_read = filesystem.dir_read(dir_hdl, name, type);
-    if (std::holds_alternative<littlefs::Error>(rc_dir_read))
-    {
-      // Error::NOENT signals end of dir contents reached
-      if (std::get<littlefs::Error>(rc_dir_read) == littlefs::Error::NOENT)
-      {
-        (void)filesystem.dir_close(dir_hdl);
-        break;
-      }
-      Serial.print("dir_read failed with error code ");
-      Serial.println(static_cast<int>(std::get<littlefs::Error>(rc_dir_read)));
-      return;
-    }
-    Serial.print(type == littlefs::Type::DIR ? "DIR" : "FILE");
+    Serial.print("dir_entries failed with error code ");
+    Serial.println(static_cast<int>(std::get<littlefs::Error>(rc_dir_entries)));
+    return;
+  }
+  auto & dir_entries = std::get<littlefs::DirRange>(rc_dir_entries);
+  for (auto const entry : dir_entries)
+  {
+    Serial.print(entry.type() == littlefs::Type::DIR ? "DIR" : "FILE");
     Serial.print('\t');
-    Serial.print(name.c_str());
+    Serial.write(entry.name().data(), entry.name().size());
     Serial.print('\t');
-    Serial.println(std::get<size_t>(rc_dir_read));
+    Serial.println(entry.size());
+  }
+  if (auto const err_dir_entries = dir_entries.error(); err_dir_entries.has_value())
+  {
+    Serial.print("dir_read failed with error code ");
+    Serial.println(static_cast<int>(err_dir_entries.value()));
+    return;
   }
+  (void)filesystem.dir_close(dir_hdl);
 
   // release any resources we were using
   (void)filesystem.unmount();
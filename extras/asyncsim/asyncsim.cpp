@@ -0,0 +1,244 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host check of AsyncBlockDevice against a simulated DMA-driven
+ * device. A transfer is started by the submit functions and only
+ * takes effect once its delay has elapsed: either a separate
+ * thread standing in for the DMA completion interrupt finishes
+ * it, or, with -p, the poll function does, as for a driver
+ * without completion interrupt. Meanwhile the yield function runs
+ * other work of a cooperative scheduler, here a counter.
+ *
+ * A file is written, synced, read back and compared, then the
+ * elapsed time and the number of yields (i.e. the work done while
+ * transfers were pending) are reported.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/asyncsim/asyncsim.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o asyncsim -lpthread
+ *   ./asyncsim [-p] [-r read us] [-w prog us] [-e erase us] [-s file size]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#include <unistd.h>
+
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* RAM-backed device completing each transfer after a fixed delay
+ * per operation type, from its own thread or from poll().
+ */
+class SimulatedDmaDevice
+{
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  std::vector<uint8_t> _mem;
+  lfs_size_t const _block_size;
+  std::chrono::microseconds const _read, _prog, _erase;
+  bool const _threaded;
+
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  std::function<void()> _job;
+  Clock::time_point _deadline;
+  bool _stop;
+  std::thread _thread;
+
+  littlefs::AsyncBlockDevice * _dev;
+
+  int start(std::chrono::microseconds const delay, std::function<void()> job)
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    _job = std::move(job);
+    _deadline = Clock::now() + delay;
+    _cv.notify_one();
+    return LFS_ERR_OK;
+  }
+  /* Runs the pending transfer if due, then completes it. */
+  void finish(std::unique_lock<std::mutex> & lock)
+  {
+    auto job = std::move(_job);
+    _job = nullptr;
+    lock.unlock();
+    job();
+    _dev->complete(LFS_ERR_OK);
+    lock.lock();
+  }
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(_mtx);
+    while (!_stop)
+    {
+      if (!_job)
+        _cv.wait(lock);
+      else if (Clock::now() < _deadline)
+        _cv.wait_until(lock, _deadline);
+      else
+        finish(lock);
+    }
+  }
+
+public:
+  SimulatedDmaDevice(lfs_size_t const block_size, lfs_size_t const block_count, uint32_t const read_us, uint32_t const prog_us, uint32_t const erase_us, bool const threaded)
+  : _mem(static_cast<size_t>(block_size) * block_count, 0xFF)
+  , _block_size{block_size}
+  , _read{read_us}
+  , _prog{prog_us}
+  , _erase{erase_us}
+  , _threaded{threaded}
+  , _stop{false}
+  , _dev{nullptr}
+  { }
+  ~SimulatedDmaDevice()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mtx);
+      _stop = true;
+      _cv.notify_one();
+    }
+    if (_thread.joinable())
+      _thread.join();
+  }
+
+  void attach(littlefs::AsyncBlockDevice & dev)
+  {
+    _dev = &dev;
+    if (_threaded)
+      _thread = std::thread([this] { run(); });
+  }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    return start(_read, [=] { memcpy(buffer, &_mem[static_cast<size_t>(block) * _block_size + off], size); });
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    return start(_prog, [=] { memcpy(&_mem[static_cast<size_t>(block) * _block_size + off], buffer, size); });
+  }
+  int erase(lfs_block_t const block)
+  {
+    return start(_erase, [=] { memset(&_mem[static_cast<size_t>(block) * _block_size], 0xFF, _block_size); });
+  }
+  void poll()
+  {
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (_job && Clock::now() >= _deadline)
+      finish(lock);
+  }
+};
+
+/**************************************************************************************
+ * GLOBAL VARIABLES
+ **************************************************************************************/
+
+static uint64_t yields = 0;
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+static SimulatedDmaDevice & sim(littlefs::AsyncBlockDevice & dev) { return *static_cast<SimulatedDmaDevice *>(dev.context()); }
+
+static int read_submit (littlefs::AsyncBlockDevice & dev, lfs_block_t block, lfs_off_t off, void * buffer, lfs_size_t size)       { return sim(dev).read(block, off, buffer, size); }
+static int prog_submit (littlefs::AsyncBlockDevice & dev, lfs_block_t block, lfs_off_t off, const void * buffer, lfs_size_t size) { return sim(dev).prog(block, off, buffer, size); }
+static int erase_submit(littlefs::AsyncBlockDevice & dev, lfs_block_t block)                                                     { return sim(dev).erase(block); }
+static void poll(littlefs::AsyncBlockDevice & dev) { sim(dev).poll(); }
+
+/* Stands in for switching to other tasks. */
+static void yield()
+{
+  yields++;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  using namespace littlefs;
+
+  bool polled = false;
+  uint32_t read_us = 20, prog_us = 50, erase_us = 500;
+  size_t file_size = 20000;
+  for (int opt; (opt = getopt(argc, argv, "pr:w:e:s:")) != -1; )
+  {
+    switch (opt)
+    {
+    case 'p': polled    = true; break;
+    case 'r': read_us   = std::strtoul(optarg, nullptr, 0); break;
+    case 'w': prog_us   = std::strtoul(optarg, nullptr, 0); break;
+    case 'e': erase_us  = std::strtoul(optarg, nullptr, 0); break;
+    case 's': file_size = std::strtoul(optarg, nullptr, 0); break;
+    default:
+      fprintf(stderr, "usage: %s [-p] [-r read us] [-w prog us] [-e erase us] [-s file size]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  lfs_size_t const block_size = 4096, block_count = 64;
+  SimulatedDmaDevice dma(block_size, block_count, read_us, prog_us, erase_us, !polled);
+  AsyncBlockDevice dev(read_submit, prog_submit, erase_submit, polled ? poll : nullptr, yield, &dma);
+  dma.attach(dev);
+
+  FilesystemConfig cfg(AsyncBlockDevice::read, AsyncBlockDevice::prog, AsyncBlockDevice::erase, AsyncBlockDevice::sync,
+                       16, 16, block_size, block_count, 500, 256, 16);
+  cfg.set_context(&dev);
+  Filesystem fs(cfg);
+
+  std::vector<uint8_t> data(file_size), back(file_size + 1);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<uint8_t>(i * 131 + (i >> 8));
+
+  auto const start = std::chrono::steady_clock::now();
+  bool ok = !fs.format() && !fs.mount();
+
+  auto fd = fs.open("data", OpenFlag::WRONLY | OpenFlag::CREAT);
+  ok = ok && std::holds_alternative<FileHandle>(fd);
+  for (size_t off = 0; ok && off < data.size(); off += 512)
+  {
+    size_t const len = std::min<size_t>(512, data.size() - off);
+    auto const rc = fs.write(std::get<FileHandle>(fd), &data[off], len);
+    ok = std::holds_alternative<size_t>(rc) && std::get<size_t>(rc) == len;
+  }
+  ok = ok && !fs.sync(std::get<FileHandle>(fd)) && !fs.close(std::get<FileHandle>(fd));
+
+  fd = fs.open("data", OpenFlag::RDONLY);
+  ok = ok && std::holds_alternative<FileHandle>(fd);
+  if (ok)
+  {
+    auto const rc = fs.read(std::get<FileHandle>(fd), back.data(), back.size());
+    ok = !fs.close(std::get<FileHandle>(fd)) && std::holds_alternative<size_t>(rc) && std::get<size_t>(rc) == data.size() &&
+         std::equal(data.begin(), data.end(), back.begin());
+  }
+  ok = !fs.unmount() && ok;
+  double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%s completion, read/prog/erase %u/%u/%u us, %zu byte round trip: %.1f ms, %llu yields\n",
+         polled ? "polled" : "interrupt", read_us, prog_us, erase_us, file_size, ms, static_cast<unsigned long long>(yields));
+  printf("%s\n", ok ? "data verified" : "FAILED");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,170 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host benchmark of the block device call overhead. The same RAM
+ * block device is configured twice:
+ *
+ *  - BlockDeviceConfig<RamBlockDevice>, the device instance being
+ *    passed via lfs_config::context to inlined member functions.
+ *  - FilesystemConfig with +[] lambdas reaching a global device,
+ *    as the examples did before BlockDeviceConfig.
+ *
+ * First the read and prog callbacks are called directly through
+ * lfs_config, the way lfs.c does, with small transfers so that the
+ * call itself dominates. Then a file is written, synced and read
+ * back in small chunks through the Filesystem. Both images must
+ * end up identical.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/callbench/callbench.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o callbench
+ *   ./callbench [calls] [file size]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+/**************************************************************************************
+ * GLOBAL CONSTANTS
+ **************************************************************************************/
+
+static lfs_size_t constexpr BLOCK_SIZE  = 4096;
+static lfs_size_t constexpr BLOCK_COUNT = 512;
+static lfs_size_t constexpr XFER_SIZE   = 16;
+
+/**************************************************************************************
+ * GLOBAL VARIABLES
+ **************************************************************************************/
+
+static std::vector<uint8_t> global_mem(static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT, 0xFF);
+static littlefs::RamBlockDevice global_ram(global_mem.data(), BLOCK_SIZE, BLOCK_COUNT);
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+/* Calls the callbacks like lfs.c, without the compiler seeing
+ * which functions are configured.
+ */
+__attribute__((noinline)) static int callbacks(const struct lfs_config * c, size_t const calls)
+{
+  uint8_t buf[XFER_SIZE] = {0};
+  int err = 0;
+  for (size_t n = 0; n < calls; n++)
+  {
+    lfs_block_t const block = n % c->block_count;
+    lfs_off_t const off = (n * XFER_SIZE) % c->block_size;
+    err |= c->prog(c, block, off, buf, sizeof(buf));
+    err |= c->read(c, block, off, buf, sizeof(buf));
+  }
+  return err;
+}
+
+/* Returns the ns per read+prog pair, negative on error. */
+static double call_overhead(littlefs::FilesystemConfig & cfg, size_t const calls)
+{
+  const struct lfs_config * volatile c = &cfg.raw_cfg();
+  auto const start = std::chrono::steady_clock::now();
+  int const err = callbacks(c, calls);
+  double const ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  return err ? -1.0 : ns / calls;
+}
+
+/* Returns the ms for writing, syncing and reading back the file
+ * in XFER_SIZE chunks, negative on error.
+ */
+static double workload(littlefs::FilesystemConfig & cfg, size_t const file_size)
+{
+  using namespace littlefs;
+
+  Filesystem fs(cfg);
+  if (fs.format() || fs.mount())
+    return -1.0;
+
+  uint8_t buf[XFER_SIZE];
+  bool ok = true;
+  auto const start = std::chrono::steady_clock::now();
+  auto fd = fs.open("data", OpenFlag::WRONLY | OpenFlag::CREAT | OpenFlag::TRUNC);
+  ok = std::holds_alternative<FileHandle>(fd);
+  for (size_t off = 0; ok && off < file_size; off += sizeof(buf))
+  {
+    for (size_t i = 0; i < sizeof(buf); i++)
+      buf[i] = static_cast<uint8_t>((off + i) * 7);
+    auto const rc = fs.write(std::get<FileHandle>(fd), buf, sizeof(buf));
+    ok = std::holds_alternative<size_t>(rc) && std::get<size_t>(rc) == sizeof(buf);
+    if (ok && (off % 4096) == 4096 - sizeof(buf))
+      ok = !fs.sync(std::get<FileHandle>(fd));
+  }
+  ok = ok && !fs.close(std::get<FileHandle>(fd));
+
+  fd = fs.open("data", OpenFlag::RDONLY);
+  ok = ok && std::holds_alternative<FileHandle>(fd);
+  for (size_t off = 0; ok && off < file_size; off += sizeof(buf))
+  {
+    auto const rc = fs.read(std::get<FileHandle>(fd), buf, sizeof(buf));
+    ok = std::holds_alternative<size_t>(rc) && std::get<size_t>(rc) == sizeof(buf);
+    for (size_t i = 0; ok && i < sizeof(buf); i++)
+      ok = buf[i] == static_cast<uint8_t>((off + i) * 7);
+  }
+  ok = ok && !fs.close(std::get<FileHandle>(fd));
+  double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  ok = !fs.unmount() && ok;
+  return ok ? ms : -1.0;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  using namespace littlefs;
+
+  size_t const calls = (argc > 1) ? std::strtoul(argv[1], nullptr, 0) : 20000000;
+  size_t const file_size = (argc > 2) ? std::strtoul(argv[2], nullptr, 0) : 1024 * 1024;
+
+  std::vector<uint8_t> mem(static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT, 0xFF);
+  RamBlockDevice ram(mem.data(), BLOCK_SIZE, BLOCK_COUNT);
+  BlockDeviceConfig<RamBlockDevice> object_cfg(ram, XFER_SIZE, XFER_SIZE, BLOCK_SIZE, BLOCK_COUNT, 500, 256, 64);
+
+  FilesystemConfig global_cfg(
+    +[](const struct lfs_config *, lfs_block_t block, lfs_off_t off, void * buffer, lfs_size_t size) -> int { return global_ram.read(block, off, buffer, size); },
+    +[](const struct lfs_config *, lfs_block_t block, lfs_off_t off, const void * buffer, lfs_size_t size) -> int { return global_ram.prog(block, off, buffer, size); },
+    +[](const struct lfs_config *, lfs_block_t block) -> int { return global_ram.erase(block); },
+    +[](const struct lfs_config *) -> int { return global_ram.sync(); },
+    XFER_SIZE, XFER_SIZE, BLOCK_SIZE, BLOCK_COUNT, 500, 256, 64);
+
+  /* Alternating runs, best of three to damp noise. */
+  double object_ns = 1e300, global_ns = 1e300, object_ms = 1e300, global_ms = 1e300;
+  for (int run = 0; run < 3; run++)
+  {
+    object_ns = std::min(object_ns, call_overhead(object_cfg, calls));
+    global_ns = std::min(global_ns, call_overhead(global_cfg, calls));
+    object_ms = std::min(object_ms, workload(object_cfg, file_size));
+    global_ms = std::min(global_ms, workload(global_cfg, file_size));
+  }
+  bool const same = std::equal(mem.begin(), mem.end(), global_mem.begin());
+
+  printf("%zu read+prog callback pairs of %u bytes, %zu byte file in %u byte chunks\n", calls, XFER_SIZE, file_size, XFER_SIZE);
+  printf("  BlockDeviceConfig:  %6.2f ns/pair %8.1f ms/file\n", object_ns, object_ms);
+  printf("  +[] global device:  %6.2f ns/pair %8.1f ms/file\n", global_ns, global_ms);
+  printf("%s\n", same ? "images identical" : "FAILED: images differ");
+
+  bool const ok = same && object_ns >= 0 && global_ns >= 0 && object_ms >= 0 && global_ms >= 0;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
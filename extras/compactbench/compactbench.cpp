@@ -0,0 +1,160 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host benchmark of the foreground latency caused by metadata
+ * compaction, on a simulated SPI NAND flash. A few logs are
+ * appended to and synced in turn while a temporary file is
+ * created and removed now and then, the simulated device time of
+ * every operation is recorded. The workload runs without idle
+ * work and with Filesystem::maintain(1) called between the
+ * operations, each for metadata_max 0 (whole block) and 8192.
+ *
+ * Mean, p99 and worst-case operation latency as well as the idle
+ * time spent in maintain are reported, all in simulated device
+ * time, so the results do not depend on the host.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/compactbench/compactbench.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o compactbench
+ *   ./compactbench [operations]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+struct Latency
+{
+  double mean_us;
+  uint64_t p99_us;
+  uint64_t worst_us;
+  uint64_t idle_us;
+  bool ok;
+};
+
+/**************************************************************************************
+ * GLOBAL CONSTANTS
+ **************************************************************************************/
+
+static lfs_size_t constexpr BLOCK_SIZE  = 128 * 1024;
+static lfs_size_t constexpr BLOCK_COUNT = 64;
+static lfs_size_t constexpr PAGE_SIZE   = 2048;
+static unsigned constexpr LOGS = 4;
+static size_t constexpr RECORD_SIZE = 24;
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+static Latency run(size_t const operations, lfs_size_t const metadata_max, bool const idle)
+{
+  using namespace littlefs;
+
+  std::vector<uint8_t> mem(static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT, 0xFF);
+  SimulatedFlashBlockDevice dev(mem.data(), BLOCK_SIZE, BLOCK_COUNT, SPI_NAND_FLASH);
+  BlockDeviceConfig<SimulatedFlashBlockDevice> cfg(dev, PAGE_SIZE, PAGE_SIZE, BLOCK_SIZE, BLOCK_COUNT, 500, PAGE_SIZE, 16);
+  cfg.set_metadata_max(metadata_max);
+  Filesystem fs(cfg);
+
+  Latency lat{0.0, 0, 0, 0, false};
+  if (fs.format() || fs.mount())
+    return lat;
+
+  FileHandle fds[LOGS];
+  for (unsigned l = 0; l < LOGS; l++)
+  {
+    auto const fd = fs.open("log" + std::to_string(l), OpenFlag::WRONLY | OpenFlag::CREAT | OpenFlag::APPEND);
+    if (std::holds_alternative<Error>(fd))
+      return lat;
+    fds[l] = std::get<FileHandle>(fd);
+  }
+
+  std::vector<uint64_t> op_us;
+  bool ok = true;
+  uint8_t rec[RECORD_SIZE];
+  for (size_t n = 0; ok && n < operations; n++)
+  {
+    for (size_t i = 0; i < sizeof(rec); i++)
+      rec[i] = static_cast<uint8_t>(n + i);
+
+    op_us.push_back(dev.measure([&]
+    {
+      if ((n % 16) == 15)
+      {
+        auto const fd = fs.open("tmp", OpenFlag::WRONLY | OpenFlag::CREAT);
+        ok = std::holds_alternative<FileHandle>(fd) && !fs.close(std::get<FileHandle>(fd)) && !fs.remove("tmp");
+      }
+      else
+      {
+        FileHandle const fd = fds[n % LOGS];
+        auto const rc = fs.write(fd, rec, sizeof(rec));
+        ok = std::holds_alternative<size_t>(rc) && !fs.sync(fd);
+      }
+    }));
+
+    if (idle)
+      lat.idle_us += dev.measure([&]
+      {
+        ok = ok && !std::holds_alternative<Error>(fs.maintain(1));
+      });
+  }
+
+  for (auto const fd : fds)
+    ok = !fs.close(fd) && ok;
+  ok = !fs.unmount() && ok;
+
+  uint64_t sum = 0;
+  for (auto const us : op_us)
+    sum += us;
+  std::sort(op_us.begin(), op_us.end());
+  lat.mean_us = static_cast<double>(sum) / op_us.size();
+  lat.p99_us = op_us[op_us.size() * 99 / 100];
+  lat.worst_us = op_us.back();
+  lat.ok = ok;
+  return lat;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  size_t const operations = (argc > 1) ? std::strtoul(argv[1], nullptr, 0) : 5000;
+
+  printf("%zu operations on SPI NAND, %u KiB blocks, %u byte pages, simulated device time\n",
+         operations, BLOCK_SIZE / 1024, PAGE_SIZE);
+  printf("  metadata_max  idle work   mean us   p99 us  worst us   idle ms\n");
+
+  bool ok = true;
+  for (lfs_size_t const metadata_max : {lfs_size_t(0), lfs_size_t(8192)})
+  {
+    for (bool const idle : {false, true})
+    {
+      Latency const lat = run(operations, metadata_max, idle);
+      printf("  %12u  %-9s %9.1f %8llu %9llu %9.1f%s\n", metadata_max, idle ? "maintain" : "none",
+             lat.mean_us, static_cast<unsigned long long>(lat.p99_us), static_cast<unsigned long long>(lat.worst_us),
+             lat.idle_us / 1000.0, lat.ok ? "" : " FAILED");
+      ok &= lat.ok;
+    }
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
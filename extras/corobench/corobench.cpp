@@ -0,0 +1,215 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host benchmark of the C++20 awaitables of Executor. A RAM block
+ * device is slowed down to SPI NOR flash timing by a sleeping
+ * LatencyBlockDevice. The same amount of logging (writes with a
+ * sync every few records) and of computation is done twice:
+ *
+ *  - blocking: Filesystem::write/sync, then the computation.
+ *  - coroutine: a coroutine co_awaits Executor::async_write and
+ *    async_sync, served by a worker thread, while the main thread
+ *    computes until the coroutine has finished.
+ *
+ * Both runs start from a freshly formatted blank device and the log
+ * is verified after each run. The wall time of both runs
+ * shows how much of the computation overlapped the flash I/O, the
+ * device sleeping stands in for the CPU being free during transfers.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++20 -O2 -Isrc extras/corobench/corobench.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o corobench -lpthread
+ *   ./corobench [records] [records per sync] [compute units]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#ifndef LITTLEFS_HAS_COROUTINES
+# error "corobench needs a C++20 compiler with coroutine support"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+typedef littlefs::LatencyBlockDevice<littlefs::RamBlockDevice> Device;
+
+/* Coroutine started eagerly, flagging its end via 'done'. */
+struct Task
+{
+  struct promise_type
+  {
+    Task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() { }
+    void unhandled_exception() { std::abort(); }
+  };
+};
+
+/**************************************************************************************
+ * GLOBAL CONSTANTS
+ **************************************************************************************/
+
+static lfs_size_t constexpr BLOCK_SIZE  = 4096;
+static lfs_size_t constexpr BLOCK_COUNT = 256;
+static size_t constexpr RECORD_SIZE = 64;
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+static void delay(uint32_t const us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+
+static void record(uint8_t * buf, size_t const n)
+{
+  for (size_t i = 0; i < RECORD_SIZE; i++)
+    buf[i] = static_cast<uint8_t>(n * 3 + i);
+}
+
+/* One unit of computation, a few hundred microseconds on a desktop CPU. */
+static uint32_t compute(uint32_t x)
+{
+  for (int i = 0; i < 400000; i++)
+    x = x * 1664525u + 1013904223u;
+  return x;
+}
+
+static Task logger(littlefs::Executor & ex, littlefs::FileHandle const fd, size_t const records, size_t const per_sync, std::atomic<int> & result)
+{
+  using namespace littlefs;
+
+  uint8_t buf[RECORD_SIZE];
+  for (size_t n = 0; n < records; n++)
+  {
+    record(buf, n);
+    if (std::holds_alternative<Error>(co_await ex.async_write(fd, buf, sizeof(buf))))
+      break;
+    if ((n % per_sync) == per_sync - 1 && std::holds_alternative<Error>(co_await ex.async_sync(fd)))
+      break;
+    if (n + 1 == records)
+      result = 1;
+  }
+  if (result == 0)
+    result = -1;
+}
+
+static bool verify(littlefs::Filesystem & fs, size_t const records)
+{
+  using namespace littlefs;
+
+  auto const fd = fs.open("log", OpenFlag::RDONLY);
+  if (std::holds_alternative<Error>(fd))
+    return false;
+  uint8_t buf[RECORD_SIZE], want[RECORD_SIZE];
+  bool ok = true;
+  for (size_t n = 0; ok && n < records; n++)
+  {
+    record(want, n);
+    auto const rc = fs.read(std::get<FileHandle>(fd), buf, sizeof(buf));
+    ok = std::holds_alternative<size_t>(rc) && std::get<size_t>(rc) == sizeof(buf) && std::equal(buf, buf + sizeof(buf), want);
+  }
+  return !fs.close(std::get<FileHandle>(fd)) && ok;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  using namespace littlefs;
+  typedef std::chrono::steady_clock Clock;
+
+  size_t const records = (argc > 1) ? std::strtoul(argv[1], nullptr, 0) : 2000;
+  size_t const per_sync = (argc > 2) ? std::strtoul(argv[2], nullptr, 0) : 16;
+  size_t const units = (argc > 3) ? std::strtoul(argv[3], nullptr, 0) : 10000;
+
+  std::vector<uint8_t> mem(static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT, 0xFF);
+  RamBlockDevice ram(mem.data(), BLOCK_SIZE, BLOCK_COUNT);
+  Device dev(ram, SPI_NOR_FLASH, delay);
+  BlockDeviceConfig<Device> cfg(dev, 16, 16, BLOCK_SIZE, BLOCK_COUNT, 500, 256, 64);
+  Filesystem fs(cfg);
+  if (fs.format() || fs.mount()) {
+    fprintf(stderr, "format/mount failed\n");
+    return EXIT_FAILURE;
+  }
+
+  uint32_t sink = 0;
+
+  /* Blocking: log, then compute. */
+  auto fd = fs.open("log", OpenFlag::WRONLY | OpenFlag::CREAT | OpenFlag::TRUNC);
+  if (std::holds_alternative<Error>(fd))
+    return EXIT_FAILURE;
+  auto start = Clock::now();
+  bool ok = true;
+  uint8_t buf[RECORD_SIZE];
+  for (size_t n = 0; ok && n < records; n++)
+  {
+    record(buf, n);
+    ok = !std::holds_alternative<Error>(fs.write(std::get<FileHandle>(fd), buf, sizeof(buf)));
+    if (ok && (n % per_sync) == per_sync - 1)
+      ok = !fs.sync(std::get<FileHandle>(fd));
+  }
+  double const blocking_io = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  for (size_t u = 0; u < units; u++)
+    sink = compute(sink);
+  double const blocking = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  ok = !fs.close(std::get<FileHandle>(fd)) && ok && verify(fs, records);
+
+  /* Coroutine: compute while the worker serves the coroutine's requests,
+   * on a blank device again so that both runs erase the same blocks.
+   */
+  (void)fs.unmount();
+  std::fill(mem.begin(), mem.end(), 0xFF);
+  if (fs.format() || fs.mount())
+    return EXIT_FAILURE;
+  fd = fs.open("log", OpenFlag::WRONLY | OpenFlag::CREAT | OpenFlag::TRUNC);
+  if (std::holds_alternative<Error>(fd))
+    return EXIT_FAILURE;
+  Executor ex(fs);
+  std::atomic<bool> stop{false};
+  std::atomic<int> result{0};
+  std::thread worker([&]
+  {
+    while (!stop.load(std::memory_order_acquire))
+      if (ex.process() == 0)
+        std::this_thread::yield();
+  });
+  start = Clock::now();
+  logger(ex, std::get<FileHandle>(fd), records, per_sync, result);
+  for (size_t u = 0; u < units; u++)
+    sink = compute(sink);
+  double const coroutine_compute = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  while (result == 0)
+    delay(100);
+  double const coroutine = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  stop.store(true, std::memory_order_release);
+  worker.join();
+  ok = !fs.close(std::get<FileHandle>(fd)) && ok && result == 1 && verify(fs, records);
+  (void)fs.unmount();
+
+  printf("%zu records of %zu bytes, sync every %zu, %zu compute units, SPI NOR timing\n", records, RECORD_SIZE, per_sync, units);
+  printf("  blocking:  %8.1f ms (I/O %.1f ms)\n", blocking, blocking_io);
+  printf("  coroutine: %8.1f ms (computation done after %.1f ms)\n", coroutine, coroutine_compute);
+  printf("%s (%u)\n", ok ? "logs verified" : "FAILED", sink & 1);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
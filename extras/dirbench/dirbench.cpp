@@ -0,0 +1,252 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host benchmark of large directories on a RAM block device.
+ *
+ * First a single directory is grown to the given number of empty
+ * files in four steps. At each size, creating the next files and
+ * looking up sampled existing (open) and missing names are timed,
+ * at the final size removing files as well. This runs without and
+ * with the metadata pair summary cache (set_dircache).
+ *
+ * Then positioning the directory at sampled entries is timed with
+ * dir_seek_name against rewinding and reading entries up to the
+ * name, and a prefix scan with dir_entries(dd, prefix) against
+ * filtering a full listing.
+ *
+ * Wall time and the number of block device reads are reported
+ * for each operation.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/dirbench/dirbench.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o dirbench
+ *   ./dirbench [number of files] [dircache slots]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+typedef littlefs::StatsBlockDevice<littlefs::RamBlockDevice> Device;
+
+/**************************************************************************************
+ * GLOBAL CONSTANTS
+ **************************************************************************************/
+
+static lfs_size_t constexpr BLOCK_SIZE  = 4096;
+static lfs_size_t constexpr BLOCK_COUNT = 4096;
+static size_t constexpr SAMPLES = 200;
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+static std::string file_name(size_t const n)
+{
+  char name[24];
+  snprintf(name, sizeof(name), "f%06zu", n);
+  return name;
+}
+
+/* Runs func, prints its wall time and device reads per call. */
+template <typename Func>
+static bool measure(char const * what, Device & dev, size_t const calls, Func && func)
+{
+  dev.reset();
+  auto const start = std::chrono::steady_clock::now();
+  bool const ok = func();
+  double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  printf("  %-28s %10.3f ms/call %10.1f reads/call\n", what, ms / calls, static_cast<double>(dev.stats().reads) / calls);
+  if (!ok)
+    printf("  %s failed\n", what);
+  return ok;
+}
+
+static bool create_files(Device & dev, littlefs::Filesystem & fs, size_t const from, size_t const to)
+{
+  using namespace littlefs;
+  return measure("create", dev, to - from, [&]
+  {
+    for (size_t n = from; n < to; n++)
+    {
+      auto const fd = fs.open("dir/" + file_name(n), OpenFlag::WRONLY | OpenFlag::CREAT);
+      if (std::holds_alternative<Error>(fd) || fs.close(std::get<FileHandle>(fd)))
+        return false;
+    }
+    return true;
+  });
+}
+
+/* Create, lookup and remove against directory size, on a fresh
+ * filesystem using 'slots' dircache entries.
+ */
+static bool sweep(size_t const files, lfs_size_t const slots)
+{
+  using namespace littlefs;
+
+  std::vector<uint8_t> mem(static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT, 0xFF);
+  RamBlockDevice ram(mem.data(), BLOCK_SIZE, BLOCK_COUNT);
+  Device dev(ram);
+  BlockDeviceConfig<Device> cfg(dev, 16, 16, BLOCK_SIZE, BLOCK_COUNT, 500, 256, 64);
+  cfg.set_dircache(slots);
+  Filesystem fs(cfg);
+  if (fs.format() || fs.mount() || fs.mkdir("dir"))
+    return false;
+
+  printf("dircache %u slots\n", slots);
+  bool ok = true;
+  for (size_t step = 1, size = 0; step <= 4; step++)
+  {
+    size_t const next = files * step / 4;
+    printf(" %zu -> %zu files\n", size, next);
+    ok &= create_files(dev, fs, size, next);
+    size = next;
+
+    ok &= measure("lookup existing", dev, SAMPLES, [&]
+    {
+      for (size_t s = 0; s < SAMPLES; s++)
+      {
+        auto const fd = fs.open("dir/" + file_name(s * size / SAMPLES), OpenFlag::RDONLY);
+        if (std::holds_alternative<Error>(fd) || fs.close(std::get<FileHandle>(fd)))
+          return false;
+      }
+      return true;
+    });
+    ok &= measure("lookup missing", dev, SAMPLES, [&]
+    {
+      for (size_t s = 0; s < SAMPLES; s++)
+      {
+        auto const fd = fs.open("dir/" + file_name(s * size / SAMPLES) + "x", OpenFlag::RDONLY);
+        if (!std::holds_alternative<Error>(fd) || std::get<Error>(fd) != Error::NOENT)
+          return false;
+      }
+      return true;
+    });
+  }
+  ok &= measure("remove", dev, SAMPLES, [&]
+  {
+    for (size_t s = 0; s < SAMPLES; s++)
+      if (fs.remove("dir/" + file_name(s * files / SAMPLES)))
+        return false;
+    return true;
+  });
+
+  (void)fs.unmount();
+  return ok;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  using namespace littlefs;
+
+  size_t const files = (argc > 1) ? std::strtoul(argv[1], nullptr, 0) : 10000;
+  lfs_size_t const slots = (argc > 2) ? std::strtoul(argv[2], nullptr, 0) : 256;
+
+  if (!sweep(files, 0) || !sweep(files, slots)) {
+    fprintf(stderr, "create/lookup/remove failed\n");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint8_t> mem(static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT, 0xFF);
+  RamBlockDevice ram(mem.data(), BLOCK_SIZE, BLOCK_COUNT);
+  Device dev(ram);
+  BlockDeviceConfig<Device> cfg(dev, 16, 16, BLOCK_SIZE, BLOCK_COUNT, 500, 256, 64);
+  Filesystem fs(cfg);
+  if (fs.format() || fs.mount() || fs.mkdir("dir")) {
+    fprintf(stderr, "format/mount failed\n");
+    return EXIT_FAILURE;
+  }
+
+  for (size_t n = 0; n < files; n++)
+  {
+    auto const fd = fs.open("dir/" + file_name(n), OpenFlag::WRONLY | OpenFlag::CREAT);
+    if (std::holds_alternative<Error>(fd) || fs.close(std::get<FileHandle>(fd))) {
+      fprintf(stderr, "creating file %zu failed\n", n);
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto const dd = fs.dir_open("dir");
+  if (std::holds_alternative<Error>(dd)) {
+    fprintf(stderr, "dir_open failed\n");
+    return EXIT_FAILURE;
+  }
+  DirHandle const dir = std::get<DirHandle>(dd);
+
+  printf("seek in %zu files, %zu sampled names\n", files, SAMPLES);
+
+  bool ok = true;
+  ok &= measure("seek by reading", dev, SAMPLES, [&]
+  {
+    for (size_t s = 0; s < SAMPLES; s++)
+    {
+      std::string const want = file_name(s * files / SAMPLES);
+      std::string name;
+      Type type;
+      if (fs.dir_rewind(dir))
+        return false;
+      do {
+        if (std::holds_alternative<Error>(fs.dir_read(dir, name, type)))
+          return false;
+      } while (name != want);
+    }
+    return true;
+  });
+  ok &= measure("dir_seek_name", dev, SAMPLES, [&]
+  {
+    for (size_t s = 0; s < SAMPLES; s++)
+      if (fs.dir_seek_name(dir, file_name(s * files / SAMPLES)))
+        return false;
+    return true;
+  });
+
+  /* Prefix matching the last ~1% of the entries. */
+  std::string const prefix = file_name(files - 1).substr(0, 5);
+  size_t full = 0, ranged = 0;
+  ok &= measure("prefix by full listing", dev, 1, [&]
+  {
+    if (fs.dir_rewind(dir))
+      return false;
+    auto range = fs.dir_entries(dir);
+    if (std::holds_alternative<Error>(range))
+      return false;
+    for (auto const & e : std::get<DirRange>(range))
+      full += (e.name().compare(0, prefix.size(), prefix) == 0) ? 1 : 0;
+    return true;
+  });
+  ok &= measure("dir_entries(prefix)", dev, 1, [&]
+  {
+    auto range = fs.dir_entries(dir, prefix);
+    if (std::holds_alternative<Error>(range))
+      return false;
+    for (auto const & e : std::get<DirRange>(range))
+      ranged += e.type() == Type::REG ? 1 : 0;
+    return true;
+  });
+  printf("  prefix \"%s\": %zu entries by full listing, %zu by dir_entries\n", prefix.c_str(), full, ranged);
+
+  (void)fs.dir_close(dir);
+  (void)fs.unmount();
+  return (ok && full == ranged) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
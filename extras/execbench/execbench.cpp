@@ -0,0 +1,206 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host benchmark of N producer threads logging into their own
+ * files, either calling a Filesystem guarded by a mutex via
+ * FilesystemConfig::set_lock or submitting IoRequests to an
+ * Executor whose worker thread is the only one calling into the
+ * Filesystem. Every producer writes records and syncs every few
+ * records, waiting for each request to complete. The logs are
+ * verified afterwards. With 'nor' the RAM device is slowed down to
+ * SPI NOR flash timing by a LatencyBlockDevice sleeping the thread.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/execbench/execbench.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o execbench -lpthread
+ *   ./execbench [producers] [records per producer] [records per sync] [ram|nor]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+typedef littlefs::LatencyBlockDevice<littlefs::RamBlockDevice> Device;
+
+/**************************************************************************************
+ * GLOBAL CONSTANTS
+ **************************************************************************************/
+
+static lfs_size_t constexpr BLOCK_SIZE  = 4096;
+static lfs_size_t constexpr BLOCK_COUNT = 2048;
+static size_t constexpr RECORD_SIZE = 32;
+
+/**************************************************************************************
+ * GLOBAL VARIABLES
+ **************************************************************************************/
+
+static std::recursive_mutex mtx;
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+static void delay(uint32_t const us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+
+static int lock  (const struct lfs_config *) { mtx.lock();   return LFS_ERR_OK; }
+static int unlock(const struct lfs_config *) { mtx.unlock(); return LFS_ERR_OK; }
+
+static void record(uint8_t * buf, unsigned const producer, size_t const n)
+{
+  for (size_t i = 0; i < RECORD_SIZE; i++)
+    buf[i] = static_cast<uint8_t>(producer * 13 + n * 5 + i);
+}
+
+static void wait(littlefs::IoRequest const & req)
+{
+  while (!req.done())
+    std::this_thread::yield();
+}
+
+/* Runs 'producers' threads calling produce(thread, fd) on their own
+ * open log, returns the elapsed time in seconds or a negative value
+ * on error. The logs are verified afterwards.
+ */
+template <typename Produce>
+static double run(littlefs::Filesystem & fs, unsigned const producers, size_t const records, Produce && produce)
+{
+  using namespace littlefs;
+
+  std::vector<FileHandle> fds;
+  for (unsigned p = 0; p < producers; p++)
+  {
+    auto const fd = fs.open("log" + std::to_string(p), OpenFlag::WRONLY | OpenFlag::CREAT | OpenFlag::TRUNC);
+    if (std::holds_alternative<Error>(fd))
+      return -1.0;
+    fds.push_back(std::get<FileHandle>(fd));
+  }
+
+  std::atomic<bool> ok{true};
+  std::vector<std::thread> pool;
+  auto const start = std::chrono::steady_clock::now();
+  for (unsigned p = 0; p < producers; p++)
+    pool.emplace_back([&, p] { if (!produce(p, fds[p])) ok = false; });
+  for (auto & t : pool)
+    t.join();
+  double const s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (auto const fd : fds)
+    ok = !fs.close(fd) && ok;
+
+  uint8_t buf[RECORD_SIZE], want[RECORD_SIZE];
+  for (unsigned p = 0; ok && p < producers; p++)
+  {
+    auto const fd = fs.open("log" + std::to_string(p), OpenFlag::RDONLY);
+    if (std::holds_alternative<Error>(fd))
+      return -1.0;
+    for (size_t n = 0; ok && n < records; n++)
+    {
+      record(want, p, n);
+      auto const rc = fs.read(std::get<FileHandle>(fd), buf, sizeof(buf));
+      ok = std::holds_alternative<size_t>(rc) && std::get<size_t>(rc) == sizeof(buf) && std::equal(buf, buf + sizeof(buf), want);
+    }
+    ok = !fs.close(std::get<FileHandle>(fd)) && ok;
+  }
+
+  return ok ? s : -1.0;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  using namespace littlefs;
+
+  unsigned const producers = (argc > 1) ? std::strtoul(argv[1], nullptr, 0) : 8;
+  size_t const records = (argc > 2) ? std::strtoul(argv[2], nullptr, 0) : 3000;
+  size_t const per_sync = (argc > 3) ? std::strtoul(argv[3], nullptr, 0) : 8;
+  bool const nor = (argc > 4) && std::string(argv[4]) == "nor";
+
+  std::vector<uint8_t> mem(static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT, 0xFF);
+  RamBlockDevice ram(mem.data(), BLOCK_SIZE, BLOCK_COUNT);
+  Device dev(ram, SPI_NOR_FLASH, nor ? delay : nullptr);
+  BlockDeviceConfig<Device> cfg(dev, 16, 16, BLOCK_SIZE, BLOCK_COUNT, 500, 256, 64);
+  cfg.set_lock(lock, unlock);
+  Filesystem fs(cfg);
+  if (fs.format() || fs.mount()) {
+    fprintf(stderr, "format/mount failed\n");
+    return EXIT_FAILURE;
+  }
+
+  double const locked = run(fs, producers, records, [&](unsigned const p, FileHandle const fd)
+  {
+    uint8_t buf[RECORD_SIZE];
+    for (size_t n = 0; n < records; n++)
+    {
+      record(buf, p, n);
+      if (std::holds_alternative<Error>(fs.write(fd, buf, sizeof(buf))))
+        return false;
+      if ((n % per_sync) == per_sync - 1 && fs.sync(fd))
+        return false;
+    }
+    return true;
+  });
+
+  Executor ex(fs);
+  std::atomic<bool> stop{false};
+  std::thread worker([&]
+  {
+    while (!stop.load(std::memory_order_acquire))
+      if (ex.process() == 0)
+        std::this_thread::yield();
+  });
+  double const executor = run(fs, producers, records, [&](unsigned const p, FileHandle const fd)
+  {
+    uint8_t buf[RECORD_SIZE];
+    for (size_t n = 0; n < records; n++)
+    {
+      record(buf, p, n);
+      IoRequest w = IoRequest::write(fd, buf, sizeof(buf));
+      ex.submit(w);
+      wait(w);
+      if (std::holds_alternative<Error>(w.result()))
+        return false;
+      if ((n % per_sync) == per_sync - 1)
+      {
+        IoRequest s = IoRequest::sync(fd);
+        ex.submit(s);
+        wait(s);
+        if (std::holds_alternative<Error>(s.result()))
+          return false;
+      }
+    }
+    return true;
+  });
+  stop.store(true, std::memory_order_release);
+  worker.join();
+  (void)fs.unmount();
+
+  printf("%u producers x %zu records of %zu bytes, sync every %zu records, %s device\n", producers, records, RECORD_SIZE, per_sync, nor ? "NOR" : "RAM");
+  printf("  mutex:    %.3f s%s\n", locked,   locked   < 0 ? " FAILED" : "");
+  printf("  executor: %.3f s%s\n", executor, executor < 0 ? " FAILED" : "");
+
+  return (locked < 0 || executor < 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
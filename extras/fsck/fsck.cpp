@@ -0,0 +1,625 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host tool verifying a littlefs image, e.g. a flash dump of a
+ * returned unit. The image is parsed directly rather than mounted,
+ * so a damaged image is reported rather than repaired:
+ *
+ *  - every metadata pair reachable from the root directory or the
+ *    tail list is fetched like lfs_dir_fetch does, verifying the
+ *    CRC of every commit. Directory entries, tails and the global
+ *    state delta of valid commits are replayed.
+ *  - every file's CTZ skip-list is walked from its last block,
+ *    checking block numbers, block count and all skip pointers.
+ *  - every block is owned by at most one metadata pair or file.
+ *
+ * Metadata pairs of different directories and files are checked
+ * in parallel by a thread pool. The report lists the blocks and
+ * extents (runs of consecutive blocks) of every file, metadata
+ * pairs and unreferenced blocks still holding data (neither of
+ * which littlefs needs), the pending global state and the revision
+ * counts of the metadata pairs, which grow with every erase.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/fsck/fsck.cpp lfs_util.o -o fsck -lpthread
+ *   ./fsck [-b block size] [-j threads] [-q] image.bin
+ *
+ * The block size is taken from the superblock unless given. The
+ * exit status is non-zero if any error was found.
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <littlefs-v2.5.1/lfs.h>
+#include <littlefs-v2.5.1/lfs_util.h>
+
+#include <unistd.h>
+
+#include <map>
+#include <mutex>
+#include <queue>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+/**************************************************************************************
+ * GLOBAL CONSTANTS
+ **************************************************************************************/
+
+static lfs_block_t const LFS_BLOCK_NULL = 0xFFFFFFFF;
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+typedef uint32_t lfs_tag_t;
+
+struct Entry
+{
+  uint16_t type;        /* LFS_TYPE_REG, LFS_TYPE_DIR, LFS_TYPE_SUPERBLOCK or 0. */
+  std::string name;
+  uint16_t struct_type; /* LFS_TYPE_DIRSTRUCT, LFS_TYPE_CTZSTRUCT, LFS_TYPE_INLINESTRUCT or 0. */
+  uint32_t struct_data[2];
+  std::vector<uint8_t> inline_data;
+};
+
+struct Mdir
+{
+  lfs_block_t pair[2];  /* Active block first. */
+  uint32_t rev[2];
+  bool valid;
+  bool has_tail;
+  bool split;           /* Tail continues this directory (hard tail). */
+  lfs_block_t tail[2];
+  uint32_t gdelta[3];
+  bool checkpoint;
+  bool torn;            /* Last commit fails its CRC, e.g. cut by power loss. */
+  std::vector<Entry> entries;
+  std::string path;     /* Directory the pair belongs to. */
+};
+
+struct File
+{
+  std::string path;
+  uint64_t mdir;        /* Metadata pair and id of the entry. */
+  uint16_t id;
+  lfs_block_t head;
+  lfs_size_t size;
+  std::vector<lfs_block_t> blocks;
+};
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Fixed number of workers running submitted tasks, which may
+ * submit further tasks. wait() returns once all are done.
+ */
+class ThreadPool
+{
+private:
+  std::vector<std::thread> _workers;
+  std::queue<std::function<void()>> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _task_cv;
+  std::condition_variable _done_cv;
+  size_t _pending;
+  bool _stop;
+
+public:
+  ThreadPool(size_t const threads)
+  : _pending{0}
+  , _stop{false}
+  {
+    for (size_t t = 0; t < threads; t++)
+      _workers.emplace_back([this]
+      {
+        for (;;)
+        {
+          std::function<void()> task;
+          {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _task_cv.wait(lock, [this] { return _stop || !_tasks.empty(); });
+            if (_tasks.empty())
+              return;
+            task = std::move(_tasks.front());
+            _tasks.pop();
+          }
+          task();
+          std::lock_guard<std::mutex> lock(_mutex);
+          if (--_pending == 0)
+            _done_cv.notify_all();
+        }
+      });
+  }
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _task_cv.notify_all();
+    for (auto & w : _workers)
+      w.join();
+  }
+
+  void submit(std::function<void()> task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _tasks.push(std::move(task));
+      _pending++;
+    }
+    _task_cv.notify_one();
+  }
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [this] { return _pending == 0; });
+  }
+};
+
+class Checker
+{
+private:
+  std::vector<uint8_t> const & _img;
+  lfs_size_t const _block_size;
+  lfs_size_t const _block_count;
+
+  std::mutex _mutex;
+  std::map<uint64_t, Mdir> _mdirs;
+  std::vector<File> _files;
+  std::vector<std::string> _errors;
+  std::vector<std::atomic<uint8_t>> _owners;
+
+  static uint64_t key(lfs_block_t const a, lfs_block_t const b) { return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b); }
+
+  uint32_t le32(lfs_block_t const block, lfs_off_t const off) const
+  {
+    uint32_t v;
+    memcpy(&v, &_img[static_cast<size_t>(block) * _block_size + off], sizeof(v));
+    return lfs_fromle32(v);
+  }
+  uint32_t be32(lfs_block_t const block, lfs_off_t const off) const
+  {
+    uint32_t v;
+    memcpy(&v, &_img[static_cast<size_t>(block) * _block_size + off], sizeof(v));
+    return lfs_frombe32(v);
+  }
+
+  void error(std::string const & msg)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _errors.push_back(msg);
+  }
+  void own(lfs_block_t const block, std::string const & owner)
+  {
+    if (_owners[block].fetch_add(1) == 1)
+      error("block " + std::to_string(block) + " is used more than once, last by " + owner);
+  }
+
+  /* Replays the valid commits of one block, false if there are none. */
+  bool replay(lfs_block_t const block, Mdir & dir) const
+  {
+    lfs_off_t off = sizeof(uint32_t);
+    lfs_tag_t ptag = 0xffffffff;
+    uint32_t crc = lfs_crc(0xffffffff, &_img[static_cast<size_t>(block) * _block_size], sizeof(uint32_t));
+    Mdir temp = dir;
+    bool found = false;
+
+    while (off + sizeof(lfs_tag_t) <= _block_size)
+    {
+      uint8_t const * const at = &_img[static_cast<size_t>(block) * _block_size + off];
+      crc = lfs_crc(crc, at, sizeof(lfs_tag_t));
+      lfs_tag_t const tag = be32(block, off) ^ ptag;
+      if (tag & 0x80000000)
+        break;
+
+      uint16_t const type3 = (tag & 0x7ff00000) >> 20;
+      uint16_t const type1 = type3 & 0x700;
+      uint16_t const id    = (tag & 0x000ffc00) >> 10;
+      bool const deleted   = (tag & 0x3ff) == 0x3ff;
+      lfs_size_t const size = deleted ? 0 : (tag & 0x3ff);
+      if (off + sizeof(lfs_tag_t) + size > _block_size)
+        break;
+      ptag = tag;
+
+      if (type1 == LFS_TYPE_CRC)
+      {
+        if (off + 2 * sizeof(uint32_t) > _block_size || le32(block, off + sizeof(lfs_tag_t)) != crc) {
+          dir.torn = true;
+          break;
+        }
+        ptag ^= static_cast<lfs_tag_t>(type3 & 1) << 31;
+        dir = temp;
+        found = true;
+        crc = 0xffffffff;
+        off += sizeof(lfs_tag_t) + size;
+        continue;
+      }
+
+      crc = lfs_crc(crc, at + sizeof(lfs_tag_t), size);
+
+      if (type1 == LFS_TYPE_SPLICE) {
+        if (type3 == LFS_TYPE_CREATE && id <= temp.entries.size())
+          temp.entries.insert(temp.entries.begin() + id, Entry{});
+        else if (type3 == LFS_TYPE_DELETE && id < temp.entries.size())
+          temp.entries.erase(temp.entries.begin() + id);
+      } else if (type1 == LFS_TYPE_NAME) {
+        if (id >= temp.entries.size())
+          temp.entries.resize(id + 1);
+        temp.entries[id].type = type3;
+        temp.entries[id].name.assign(reinterpret_cast<char const *>(at + sizeof(lfs_tag_t)), size);
+      } else if (type1 == LFS_TYPE_STRUCT && !deleted && id < 0x3ff) {
+        if (id >= temp.entries.size())
+          temp.entries.resize(id + 1);
+        Entry & e = temp.entries[id];
+        e.struct_type = type3;
+        if (type3 == LFS_TYPE_INLINESTRUCT) {
+          e.inline_data.assign(at + sizeof(lfs_tag_t), at + sizeof(lfs_tag_t) + size);
+        } else if (size >= 8) {
+          e.struct_data[0] = le32(block, off + 4);
+          e.struct_data[1] = le32(block, off + 8);
+        }
+      } else if (type1 == LFS_TYPE_TAIL && size >= 8) {
+        temp.has_tail = true;
+        temp.split = type3 & 1;
+        temp.tail[0] = le32(block, off + 4);
+        temp.tail[1] = le32(block, off + 8);
+      } else if (type3 == LFS_TYPE_MOVESTATE && size >= 12) {
+        for (int i = 0; i < 3; i++)
+          temp.gdelta[i] = le32(block, off + 4 + 4 * i);
+      } else if (type3 == LFS_TYPE_USERATTR + LFS_CHECKPOINT_ATTR && id == 0) {
+        temp.checkpoint = !deleted;
+      }
+
+      off += sizeof(lfs_tag_t) + size;
+    }
+    return found;
+  }
+
+  /* Fetches a metadata pair like lfs_dir_fetch. */
+  Mdir fetch(lfs_block_t const a, lfs_block_t const b) const
+  {
+    Mdir dir{};
+    dir.pair[0] = a;
+    dir.pair[1] = b;
+    dir.tail[0] = dir.tail[1] = LFS_BLOCK_NULL;
+    if (a >= _block_count || b >= _block_count)
+      return dir;
+
+    dir.rev[0] = le32(a, 0);
+    dir.rev[1] = le32(b, 0);
+    if (static_cast<int32_t>(dir.rev[1] - dir.rev[0]) > 0) {
+      std::swap(dir.pair[0], dir.pair[1]);
+      std::swap(dir.rev[0], dir.rev[1]);
+    }
+    for (int i = 0; i < 2 && !dir.valid; i++)
+    {
+      Mdir temp = dir;
+      if (replay(dir.pair[0], temp)) {
+        temp.valid = true;
+        dir = temp;
+      } else {
+        std::swap(dir.pair[0], dir.pair[1]);
+        std::swap(dir.rev[0], dir.rev[1]);
+      }
+    }
+    return dir;
+  }
+
+  /* Fetches a pair of directory 'path' and the rest of the tree below it. */
+  void visit(ThreadPool & pool, lfs_block_t const a, lfs_block_t const b, std::string const & path)
+  {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (!_mdirs.emplace(key(a, b), Mdir{}).second)
+        return;
+    }
+
+    Mdir dir = fetch(a, b);
+    dir.path = path;
+    if (!dir.valid)
+      error("metadata pair {" + std::to_string(a) + ", " + std::to_string(b) + "} of " + (path.empty() ? "/" : path) + " has no valid commit");
+
+    for (size_t id = 0; dir.valid && id < dir.entries.size(); id++)
+    {
+      Entry const & e = dir.entries[id];
+      std::string const child = path + "/" + e.name;
+      if (e.type == LFS_TYPE_DIR) {
+        if (e.struct_type != LFS_TYPE_DIRSTRUCT) {
+          error(child + ": directory without directory struct");
+          continue;
+        }
+        lfs_block_t const ca = e.struct_data[0], cb = e.struct_data[1];
+        pool.submit([this, &pool, ca, cb, child] { visit(pool, ca, cb, child); });
+      } else if (e.type == LFS_TYPE_REG) {
+        if (e.struct_type == LFS_TYPE_CTZSTRUCT) {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _files.push_back(File{child, key(a, b), static_cast<uint16_t>(id), e.struct_data[0], e.struct_data[1], {}});
+        } else if (e.struct_type == LFS_TYPE_INLINESTRUCT) {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _files.push_back(File{child, key(a, b), static_cast<uint16_t>(id), LFS_BLOCK_NULL, static_cast<lfs_size_t>(e.inline_data.size()), {}});
+        } else {
+          error(child + ": file without struct");
+        }
+      }
+    }
+
+    if (dir.valid && dir.has_tail && dir.split)
+      pool.submit([this, &pool, t0 = dir.tail[0], t1 = dir.tail[1], path] { visit(pool, t0, t1, path); });
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _mdirs[key(a, b)] = std::move(dir);
+  }
+
+  static lfs_off_t ctz_index(lfs_size_t const block_size, lfs_off_t const size)
+  {
+    lfs_off_t const b = block_size - 2 * 4;
+    lfs_off_t i = size / b;
+    if (i == 0)
+      return 0;
+    return (size - 4 * (lfs_popc(i - 1) + 2)) / b;
+  }
+
+  /* Walks a file's skip-list from its last block. */
+  void walk(File & f)
+  {
+    if (f.head == LFS_BLOCK_NULL || f.size == 0)
+      return;
+
+    lfs_off_t const last = ctz_index(_block_size, f.size - 1);
+    f.blocks.assign(last + 1, LFS_BLOCK_NULL);
+    lfs_block_t block = f.head;
+    for (lfs_off_t n = last; ; n--)
+    {
+      if (block >= _block_count) {
+        error(f.path + ": block " + std::to_string(n) + " out of range (" + std::to_string(block) + ")");
+        f.blocks.clear();
+        return;
+      }
+      f.blocks[n] = block;
+      if (n == 0)
+        break;
+      block = le32(block, 0);
+    }
+
+    for (lfs_off_t n = 1; n <= last; n++)
+      for (lfs_off_t k = 0; k <= lfs_ctz(n); k++)
+        if (le32(f.blocks[n], 4 * k) != f.blocks[n - (1U << k)]) {
+          error(f.path + ": skip pointer " + std::to_string(k) + " of block " + std::to_string(n) + " is wrong");
+          break;
+        }
+    for (auto const b : f.blocks)
+      own(b, f.path);
+  }
+
+public:
+  Checker(std::vector<uint8_t> const & img, lfs_size_t const block_size)
+  : _img{img}
+  , _block_size{block_size}
+  , _block_count{static_cast<lfs_size_t>(img.size() / block_size)}
+  , _owners(img.size() / block_size)
+  { }
+
+  /* All zero if there is no valid superblock. */
+  lfs_superblock_t superblock() const
+  {
+    Mdir const root = fetch(0, 1);
+    lfs_superblock_t sb{};
+    if (!root.valid || root.entries.empty() || root.entries[0].type != LFS_TYPE_SUPERBLOCK ||
+        root.entries[0].name != "littlefs" || root.entries[0].inline_data.size() < sizeof(sb))
+      return lfs_superblock_t{};
+    memcpy(&sb, root.entries[0].inline_data.data(), sizeof(sb));
+    sb.version     = lfs_fromle32(sb.version);
+    sb.block_size  = lfs_fromle32(sb.block_size);
+    sb.block_count = lfs_fromle32(sb.block_count);
+    sb.name_max    = lfs_fromle32(sb.name_max);
+    sb.file_max    = lfs_fromle32(sb.file_max);
+    sb.attr_max    = lfs_fromle32(sb.attr_max);
+    return sb;
+  }
+
+  int run(size_t const threads, bool const quiet)
+  {
+    ThreadPool pool(threads);
+
+    lfs_superblock_t const sb = superblock();
+    if (!sb.block_size) {
+      printf("no littlefs superblock found\n");
+      return EXIT_FAILURE;
+    }
+    if (sb.block_size != _block_size || sb.block_count > _block_count)
+      error("superblock geometry " + std::to_string(sb.block_size) + " x " + std::to_string(sb.block_count) + " does not match the image");
+    printf("version %u.%u, block size %u, block count %u, name max %u, file max %u, attr max %u%s\n",
+           sb.version >> 16, sb.version & 0xffff, _block_size, sb.block_count,
+           sb.name_max, sb.file_max, sb.attr_max, fetch(0, 1).checkpoint ? ", mount checkpoint" : "");
+
+    /* Directory tree, one task per metadata pair. */
+    pool.submit([this, &pool] { visit(pool, 0, 1, ""); });
+    pool.wait();
+
+    /* Tail list, which links every metadata pair, the global state is
+     * the sum of the deltas on it. Pairs not found in the tree are orphans.
+     */
+    std::vector<uint64_t> orphans;
+    uint32_t gstate[3] = {0, 0, 0};
+    size_t on_list = 0;
+    lfs_block_t tail[2] = {0, 1};
+    for (;;)
+    {
+      auto it = _mdirs.find(key(tail[0], tail[1]));
+      if (it == _mdirs.end()) {
+        Mdir dir = fetch(tail[0], tail[1]);
+        dir.path = "(orphan)";
+        orphans.push_back(key(tail[0], tail[1]));
+        it = _mdirs.emplace(key(tail[0], tail[1]), std::move(dir)).first;
+        if (!it->second.valid)
+          error("metadata pair {" + std::to_string(tail[0]) + ", " + std::to_string(tail[1]) + "} on the tail list has no valid commit");
+      }
+      if (++on_list > _mdirs.size()) {
+        error("tail list loops");
+        break;
+      }
+      Mdir const & dir = it->second;
+      for (int i = 0; i < 3; i++)
+        gstate[i] ^= dir.gdelta[i];
+      if (!dir.valid || !dir.has_tail || dir.tail[0] == LFS_BLOCK_NULL)
+        break;
+      tail[0] = dir.tail[0];
+      tail[1] = dir.tail[1];
+    }
+    if (on_list < _mdirs.size())
+      error(std::to_string(_mdirs.size() - on_list) + " metadata pairs of the tree are not on the tail list");
+
+    /* The source of a pending move is about to be deleted. */
+    lfs_tag_t const gtag = lfs_fromle32(gstate[0]);
+    bool const moving = (gtag & 0x70000000) >> 20;
+    uint64_t const move_mdir = key(lfs_fromle32(gstate[1]), lfs_fromle32(gstate[2]));
+    uint16_t const move_id = (gtag & 0x000ffc00) >> 10;
+    if (moving)
+      _files.erase(std::remove_if(_files.begin(), _files.end(), [&](File const & f) { return f.mdir == move_mdir && f.id == move_id; }), _files.end());
+
+    /* Metadata pairs, then files with one task per file. */
+    for (auto const & [k, dir] : _mdirs)
+      if (std::find(orphans.begin(), orphans.end(), k) == orphans.end())
+        for (auto const b : dir.pair)
+          if (b < _block_count)
+            own(b, "metadata pair of " + (dir.path.empty() ? std::string("/") : dir.path));
+    /* A power loss while relocating a metadata block leaves the new pair on
+     * the tail list, sharing a block with the old pair still in the tree.
+     */
+    size_t half_orphans = 0;
+    for (auto const k : orphans)
+      for (auto const b : _mdirs[k].pair)
+        if (b < _block_count) {
+          if (_owners[b])
+            half_orphans++;
+          else
+            own(b, "orphaned metadata pair");
+        }
+    for (auto & f : _files)
+      pool.submit([this, &f] { walk(f); });
+    pool.wait();
+
+    /* Report. */
+    std::sort(_files.begin(), _files.end(), [](File const & a, File const & b) { return a.path < b.path; });
+    size_t inlined = 0, fragmented = 0, data_blocks = 0;
+    if (!quiet)
+      printf("\n%10s %8s %8s  %s\n", "size", "blocks", "extents", "path");
+    for (auto const & f : _files)
+    {
+      size_t extents = f.blocks.empty() ? 0 : 1;
+      for (size_t i = 1; i < f.blocks.size(); i++)
+        extents += (f.blocks[i] != f.blocks[i - 1] + 1) ? 1 : 0;
+      inlined += (f.head == LFS_BLOCK_NULL) ? 1 : 0;
+      fragmented += (extents > 1) ? 1 : 0;
+      data_blocks += f.blocks.size();
+      if (!quiet)
+        printf("%10u %8zu %8zu  %s%s\n", f.size, f.blocks.size(), extents, f.path.c_str(), f.head == LFS_BLOCK_NULL ? " (inline)" : "");
+    }
+
+    size_t const torn = std::count_if(_mdirs.begin(), _mdirs.end(), [](auto const & m) { return m.second.torn; });
+    size_t stale = 0, used = 0;
+    for (lfs_block_t b = 0; b < _block_count; b++)
+    {
+      if (_owners[b]) {
+        used++;
+        continue;
+      }
+      uint8_t const * const p = &_img[static_cast<size_t>(b) * _block_size];
+      stale += std::any_of(p, p + _block_size, [](uint8_t const c) { return c != 0xFF; }) ? 1 : 0;
+    }
+
+    /* Revisions start from whatever a reused block held before. */
+    std::vector<uint32_t> revs;
+    if (!quiet)
+      printf("\n%10s %10s %10s  %s\n", "block", "block", "revision", "metadata pair of");
+    for (auto const & [k, dir] : _mdirs)
+    {
+      revs.push_back(dir.rev[0]);
+      if (!quiet)
+        printf("%10u %10u %10u  %s\n", dir.pair[0], dir.pair[1], dir.rev[0], dir.path.empty() ? "/" : dir.path.c_str());
+    }
+    std::sort(revs.begin(), revs.end());
+
+    printf("\n%zu metadata pairs (%zu orphaned, %zu half-orphaned), %zu files (%zu inlined, %zu fragmented)\n",
+           _mdirs.size(), orphans.size() - half_orphans, half_orphans, _files.size(), inlined, fragmented);
+    printf("%zu of %u blocks used (%zu by file data), %zu unreferenced blocks holding data\n",
+           used, _block_count, data_blocks, stale);
+    if (torn)
+      printf("%zu metadata pairs end in a commit failing its CRC, cut by power loss or corrupted\n", torn);
+    printf("metadata pair revisions min %u, median %u, max %u\n", revs.front(), revs[revs.size() / 2], revs.back());
+    /* Like lfs_mount, an orphan count of 0 with the top bit set is 1. */
+    lfs_size_t const pending_orphans = (gtag & 0x3ff) + (gtag >> 31);
+    if (pending_orphans)
+      printf("pending: %u orphans\n", pending_orphans);
+    if (moving)
+      printf("pending: move of id %u in {%u, %u}\n", move_id, lfs_fromle32(gstate[1]), lfs_fromle32(gstate[2]));
+
+    for (auto const & e : _errors)
+      printf("error: %s\n", e.c_str());
+    printf("%zu errors\n", _errors.size());
+    return _errors.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+};
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  lfs_size_t block_size = 0;
+  size_t threads = std::max(1U, std::thread::hardware_concurrency());
+  bool quiet = false;
+
+  for (int opt; (opt = getopt(argc, argv, "b:j:q")) != -1; )
+  {
+    switch (opt)
+    {
+    case 'b': block_size = std::strtoul(optarg, nullptr, 0); break;
+    case 'j': threads    = std::max(1UL, std::strtoul(optarg, nullptr, 0)); break;
+    case 'q': quiet      = true; break;
+    default:  optind = argc + 1; break;
+    }
+  }
+  if (optind + 1 != argc) {
+    fprintf(stderr, "usage: %s [-b block size] [-j threads] [-q] image.bin\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream in(argv[optind], std::ios::binary);
+  std::vector<uint8_t> const img{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  if (!in || img.size() < 2 * 8) {
+    fprintf(stderr, "reading %s failed\n", argv[optind]);
+    return EXIT_FAILURE;
+  }
+
+  for (lfs_size_t bs = 128; !block_size && bs <= img.size() / 2; bs *= 2)
+    if (Checker(img, bs).superblock().block_size == bs)
+      block_size = bs;
+  if (!block_size || img.size() % block_size) {
+    fprintf(stderr, "block size unknown, use -b\n");
+    return EXIT_FAILURE;
+  }
+
+  Checker checker(img, block_size);
+  return checker.run(threads, quiet);
+}
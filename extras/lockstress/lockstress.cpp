@@ -0,0 +1,188 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host stress test of a Filesystem shared by several threads via
+ * FilesystemConfig::set_lock. Every thread appends records to its
+ * own log, syncing every few records, and creates and removes
+ * small files in a shared directory in between. Afterwards every
+ * log is read back and checked. Throughput and the time the lock
+ * was held per acquisition (outermost level, as the mutex is
+ * recursive) are reported.
+ *
+ * Build and run from the repository root, optionally adding
+ * -DLFS_THREADSAFE to both compilations:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/lockstress/lockstress.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o lockstress -lpthread
+ *   ./lockstress [threads] [records per thread]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**************************************************************************************
+ * GLOBAL CONSTANTS
+ **************************************************************************************/
+
+static lfs_size_t constexpr BLOCK_SIZE  = 4096;
+static lfs_size_t constexpr BLOCK_COUNT = 1024;
+static size_t constexpr RECORD_SIZE = 48;
+
+/**************************************************************************************
+ * GLOBAL VARIABLES
+ **************************************************************************************/
+
+static std::recursive_mutex mtx;
+static thread_local unsigned depth = 0;
+static thread_local std::chrono::steady_clock::time_point acquired;
+
+/* Only modified while holding mtx. */
+static std::vector<uint32_t> hold_us;
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+static int lock(const struct lfs_config *)
+{
+  mtx.lock();
+  if (depth++ == 0)
+    acquired = std::chrono::steady_clock::now();
+  return LFS_ERR_OK;
+}
+
+static int unlock(const struct lfs_config *)
+{
+  if (--depth == 0)
+    hold_us.push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - acquired).count()));
+  mtx.unlock();
+  return LFS_ERR_OK;
+}
+
+static void record(uint8_t * buf, unsigned const thread, size_t const n)
+{
+  for (size_t i = 0; i < RECORD_SIZE; i++)
+    buf[i] = static_cast<uint8_t>(thread * 31 + n * 7 + i);
+}
+
+static bool worker(littlefs::Filesystem & fs, unsigned const thread, size_t const records)
+{
+  using namespace littlefs;
+
+  std::string const log = "log" + std::to_string(thread);
+  auto const fd = fs.open(log, OpenFlag::WRONLY | OpenFlag::CREAT | OpenFlag::TRUNC);
+  if (std::holds_alternative<Error>(fd))
+    return false;
+
+  uint8_t buf[RECORD_SIZE];
+  for (size_t n = 0; n < records; n++)
+  {
+    record(buf, thread, n);
+    auto const rc = fs.write(std::get<FileHandle>(fd), buf, sizeof(buf));
+    if (std::holds_alternative<Error>(rc) || std::get<size_t>(rc) != sizeof(buf))
+      return false;
+    if ((n % 16) == 15 && fs.sync(std::get<FileHandle>(fd)))
+      return false;
+
+    if ((n % 64) == 0)
+    {
+      std::string const tmp = "tmp/" + std::to_string(thread) + "_" + std::to_string(n);
+      auto const t = fs.open(tmp, OpenFlag::WRONLY | OpenFlag::CREAT);
+      if (std::holds_alternative<Error>(t) || fs.close(std::get<FileHandle>(t)) || fs.remove(tmp))
+        return false;
+    }
+  }
+  return !fs.close(std::get<FileHandle>(fd));
+}
+
+static bool verify(littlefs::Filesystem & fs, unsigned const thread, size_t const records)
+{
+  using namespace littlefs;
+
+  auto const fd = fs.open("log" + std::to_string(thread), OpenFlag::RDONLY);
+  if (std::holds_alternative<Error>(fd))
+    return false;
+  uint8_t buf[RECORD_SIZE], want[RECORD_SIZE];
+  bool ok = true;
+  for (size_t n = 0; ok && n < records; n++)
+  {
+    record(want, thread, n);
+    auto const rc = fs.read(std::get<FileHandle>(fd), buf, sizeof(buf));
+    ok = std::holds_alternative<size_t>(rc) && std::get<size_t>(rc) == sizeof(buf) && std::equal(buf, buf + sizeof(buf), want);
+  }
+  auto const size = fs.size(std::get<FileHandle>(fd));
+  ok = ok && std::holds_alternative<size_t>(size) && std::get<size_t>(size) == records * RECORD_SIZE;
+  return !fs.close(std::get<FileHandle>(fd)) && ok;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  using namespace littlefs;
+
+  unsigned const threads = (argc > 1) ? std::strtoul(argv[1], nullptr, 0) : 8;
+  size_t const records = (argc > 2) ? std::strtoul(argv[2], nullptr, 0) : 2000;
+
+  std::vector<uint8_t> mem(static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT, 0xFF);
+  RamBlockDevice ram(mem.data(), BLOCK_SIZE, BLOCK_COUNT);
+  BlockDeviceConfig<RamBlockDevice> cfg(ram, 16, 16, BLOCK_SIZE, BLOCK_COUNT, 500, 256, 64);
+  cfg.set_lock(lock, unlock);
+  Filesystem fs(cfg);
+  if (fs.format() || fs.mount() || fs.mkdir("tmp")) {
+    fprintf(stderr, "format/mount failed\n");
+    return EXIT_FAILURE;
+  }
+  hold_us.clear();
+
+  std::vector<std::thread> pool;
+  std::vector<char> ok(threads, 0);
+  auto const start = std::chrono::steady_clock::now();
+  for (unsigned t = 0; t < threads; t++)
+    pool.emplace_back([&, t] { ok[t] = worker(fs, t, records); });
+  for (auto & th : pool)
+    th.join();
+  double const s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<uint32_t> holds = hold_us;
+  bool passed = std::all_of(ok.begin(), ok.end(), [](char const c) { return c != 0; });
+  for (unsigned t = 0; passed && t < threads; t++)
+    passed = verify(fs, t, records);
+  (void)fs.unmount();
+
+  std::sort(holds.begin(), holds.end());
+  uint64_t sum = 0;
+  for (auto const h : holds)
+    sum += h;
+  size_t const n = holds.size();
+
+#ifdef LFS_THREADSAFE
+  printf("LFS_THREADSAFE, ");
+#endif
+  printf("%u threads x %zu records of %zu bytes: %.2f s, %.0f records/s\n",
+         threads, records, RECORD_SIZE, s, threads * records / s);
+  if (n)
+    printf("lock held %zu times: mean %.1f us, median %u us, p99 %u us, max %u us\n",
+           n, static_cast<double>(sum) / n, holds[n / 2], holds[n * 99 / 100], holds.back());
+  printf("%s\n", passed ? "all logs verified" : "FAILED");
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,343 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host tool packing a directory tree into a littlefs image, so
+ * provisioning a board is a single raw write of the image file.
+ *
+ * The allocator is started at the first block and all directories
+ * and (empty) files are created first, so their metadata pairs
+ * are packed behind the superblock. The file contents are then
+ * written in access order, i.e. the order given by the order file
+ * (one path relative to the directory per line) followed by all
+ * other files in alphabetical order. This way the blocks of each file
+ * follow each other and the files follow each other in the order
+ * they are read on first boot. Files small enough to be inlined
+ * live in their directory's metadata pair instead.
+ *
+ * The geometry must match the FilesystemConfig used on the board,
+ * the cache size must not exceed the board's cache size, as it
+ * bounds the size of inlined files.
+ *
+ * With -H the image is also written as a C++ header defining the
+ * image as a constexpr array named after the header file, together
+ * with the geometry and cache size it was built with, for mounting
+ * it from the firmware via RomBlockDevice. Trailing blocks never
+ * written are left out of the array, RomBlockDevice reads them as
+ * erased.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/mkimage/mkimage.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o mkimage
+ *   ./mkimage [-b block size] [-c block count] [-r read size] [-p prog size]
+ *             [-k cache size] [-l lookahead size] [-o order file] [-H header.h]
+ *             dir image.bin
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+#include <blockdevice/MmapBlockDevice.h>
+
+#include <unistd.h>
+
+#include <set>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Image file block device recording the blocks erased while
+ * 'owner' is set, which yields the blocks allocated for a file's
+ * data while writing it. No ranged erase is passed on, as blocks
+ * erased ahead by the allocator would be recorded for the wrong file.
+ * 'end' follows the last block written at all, blocks from there
+ * on are not part of the filesystem, even if data in front of them
+ * happens to be all 0xFF.
+ */
+class RecordingBlockDevice
+{
+private:
+  littlefs::MmapBlockDevice & _dev;
+
+public:
+  std::vector<lfs_block_t> * owner;
+  lfs_block_t end;
+
+  RecordingBlockDevice(littlefs::MmapBlockDevice & dev)
+  : _dev{dev}
+  , owner{nullptr}
+  , end{0}
+  { }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    return _dev.read(block, off, buffer, size);
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    end = (block >= end) ? block + 1 : end;
+    return _dev.prog(block, off, buffer, size);
+  }
+  int erase(lfs_block_t const block)
+  {
+    if (owner)
+      owner->push_back(block);
+    end = (block >= end) ? block + 1 : end;
+    return _dev.erase(block);
+  }
+  int sync()
+  {
+    return _dev.sync();
+  }
+};
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+static bool read_file(std::filesystem::path const & path, std::vector<uint8_t> & data)
+{
+  std::ifstream in(path, std::ios::binary);
+  data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  return !in.bad();
+}
+
+static bool failed(std::optional<littlefs::Error> const & err, char const * what, std::string const & path)
+{
+  if (err)
+    fprintf(stderr, "%s %s failed: %d\n", what, path.c_str(), static_cast<int>(err.value()));
+  return err.has_value();
+}
+
+/* Writes the first 'end' blocks of the image as a header, the array
+ * and the configuration constants are named after the header file.
+ */
+static bool write_header(std::filesystem::path const & path, littlefs::MmapBlockDevice const & image, lfs_block_t const end, lfs_config const & cfg)
+{
+  std::string name = path.stem().string();
+  for (auto & c : name)
+    if (!isalnum(static_cast<unsigned char>(c)))
+      c = '_';
+  if (name.empty() || isdigit(static_cast<unsigned char>(name.front())))
+    name.insert(0, "_");
+  std::string guard = name + "_H_";
+  std::transform(guard.begin(), guard.end(), guard.begin(), [](unsigned char c) { return toupper(c); });
+
+  size_t const size = static_cast<size_t>(end) * image.block_size();
+
+  FILE * out = fopen(path.c_str(), "w");
+  if (!out)
+    return false;
+  fprintf(out, "/* littlefs image generated by mkimage, do not edit. */\n\n");
+  fprintf(out, "#ifndef %s\n#define %s\n\n#include <cstdint>\n\n", guard.c_str(), guard.c_str());
+  fprintf(out, "inline constexpr uint32_t %s_block_size = %u;\n", name.c_str(), image.block_size());
+  fprintf(out, "inline constexpr uint32_t %s_block_count = %u;\n", name.c_str(), image.block_count());
+  fprintf(out, "inline constexpr uint32_t %s_read_size = %u;\n", name.c_str(), cfg.read_size);
+  fprintf(out, "inline constexpr uint32_t %s_prog_size = %u;\n", name.c_str(), cfg.prog_size);
+  fprintf(out, "inline constexpr uint32_t %s_cache_size = %u;\n\n", name.c_str(), cfg.cache_size);
+  fprintf(out, "alignas(4) inline constexpr uint8_t %s[%zu] = {", name.c_str(), size);
+  for (size_t i = 0; i < size; i++)
+    fprintf(out, "%s0x%02x,", (i % 16) ? " " : "\n  ", image.data()[i]);
+  fprintf(out, "\n};\n\n#endif /* %s */\n", guard.c_str());
+  return fclose(out) == 0;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  lfs_size_t block_size = 4096, block_count = 256, read_size = 16, prog_size = 16, cache_size = 256, lookahead_size = 32;
+  char const * order_file = nullptr, * header_file = nullptr;
+
+  for (int opt; (opt = getopt(argc, argv, "b:c:r:p:k:l:o:H:")) != -1; )
+  {
+    switch (opt)
+    {
+    case 'b': block_size     = std::strtoul(optarg, nullptr, 0); break;
+    case 'c': block_count    = std::strtoul(optarg, nullptr, 0); break;
+    case 'r': read_size      = std::strtoul(optarg, nullptr, 0); break;
+    case 'p': prog_size      = std::strtoul(optarg, nullptr, 0); break;
+    case 'k': cache_size     = std::strtoul(optarg, nullptr, 0); break;
+    case 'l': lookahead_size = std::strtoul(optarg, nullptr, 0); break;
+    case 'o': order_file     = optarg; break;
+    case 'H': header_file    = optarg; break;
+    default:  optind = argc + 1; break;
+    }
+  }
+  if (optind + 2 != argc) {
+    fprintf(stderr, "usage: %s [-b block size] [-c block count] [-r read size] [-p prog size]\n"
+                    "          [-k cache size] [-l lookahead size] [-o order file] [-H header.h]\n"
+                    "          dir image.bin\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  std::filesystem::path const root = argv[optind];
+
+  /* Directories in creation order, files in access order. */
+  std::vector<std::string> dirs, files;
+  std::error_code ec;
+  for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+  {
+    std::string const rel = it->path().lexically_relative(root).generic_string();
+    if (it->is_directory())
+      dirs.push_back(rel);
+    else if (it->is_regular_file())
+      files.push_back(rel);
+  }
+  if (ec) {
+    fprintf(stderr, "%s: %s\n", root.c_str(), ec.message().c_str());
+    return EXIT_FAILURE;
+  }
+  std::sort(dirs.begin(), dirs.end());
+  std::sort(files.begin(), files.end());
+
+  if (order_file)
+  {
+    std::ifstream in(order_file);
+    if (!in) {
+      perror(order_file);
+      return EXIT_FAILURE;
+    }
+    std::vector<std::string> ordered;
+    std::set<std::string> seen;
+    for (std::string line; std::getline(in, line); )
+    {
+      while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+        line.pop_back();
+      if (!line.empty() && line.front() == '/')
+        line.erase(0, 1);
+      if (std::binary_search(files.begin(), files.end(), line) && seen.insert(line).second)
+        ordered.push_back(line);
+    }
+    for (auto const & f : files)
+      if (!seen.count(f))
+        ordered.push_back(f);
+    files = ordered;
+  }
+
+  littlefs::MmapBlockDevice image(block_size);
+  if (image.open(argv[optind + 1], littlefs::MmapMode::CREATE, block_count)) {
+    fprintf(stderr, "creating %s failed\n", argv[optind + 1]);
+    return EXIT_FAILURE;
+  }
+  RecordingBlockDevice dev(image);
+
+  /* No wear leveling relocations while building the image. */
+  littlefs::BlockDeviceConfig<RecordingBlockDevice> cfg(dev, read_size, prog_size, block_size, block_count, -1, cache_size, lookahead_size);
+  littlefs::Filesystem fs(cfg);
+  if (failed(fs.format(), "format", argv[optind + 1]) || failed(fs.mount(), "mount", argv[optind + 1]) ||
+      failed(fs.alloc_seek(0), "alloc_seek", argv[optind + 1]))
+    return EXIT_FAILURE;
+
+  for (auto const & d : dirs)
+    if (failed(fs.mkdir(d), "mkdir", d))
+      return EXIT_FAILURE;
+  for (auto const & f : files)
+  {
+    auto const file = fs.open(f, littlefs::OpenFlag::WRONLY | littlefs::OpenFlag::CREAT);
+    if (std::holds_alternative<littlefs::Error>(file)) {
+      fprintf(stderr, "create %s failed\n", f.c_str());
+      return EXIT_FAILURE;
+    }
+    if (failed(fs.close(std::get<littlefs::FileHandle>(file)), "create", f))
+      return EXIT_FAILURE;
+  }
+
+  std::vector<std::vector<lfs_block_t>> blocks(files.size());
+  std::vector<uint8_t> data;
+  size_t bytes = 0;
+  for (size_t i = 0; i < files.size(); i++)
+  {
+    if (!read_file(root / files[i], data)) {
+      fprintf(stderr, "reading %s failed\n", files[i].c_str());
+      return EXIT_FAILURE;
+    }
+    auto const file = fs.open(files[i], littlefs::OpenFlag::WRONLY | littlefs::OpenFlag::TRUNC);
+    if (std::holds_alternative<littlefs::Error>(file)) {
+      fprintf(stderr, "open %s failed\n", files[i].c_str());
+      return EXIT_FAILURE;
+    }
+    dev.owner = &blocks[i];
+    auto const rc = fs.write(std::get<littlefs::FileHandle>(file), data.data(), data.size());
+    dev.owner = nullptr;
+    if (std::holds_alternative<littlefs::Error>(rc) || std::get<size_t>(rc) != data.size() || failed(fs.close(std::get<littlefs::FileHandle>(file)), "close", files[i])) {
+      fprintf(stderr, "write %s failed (image full?)\n", files[i].c_str());
+      return EXIT_FAILURE;
+    }
+    bytes += data.size();
+  }
+
+  auto const used = fs.fs_size();
+  if (failed(fs.unmount(), "unmount", argv[optind + 1]))
+    return EXIT_FAILURE;
+
+  /* Read everything back from the image. */
+  std::vector<uint8_t> back;
+  if (failed(fs.mount(), "mount", argv[optind + 1]))
+    return EXIT_FAILURE;
+  for (auto const & f : files)
+  {
+    (void)read_file(root / f, data);
+    back.assign(data.size() + 1, 0);
+    auto const file = fs.open(f, littlefs::OpenFlag::RDONLY);
+    if (std::holds_alternative<littlefs::Error>(file)) {
+      fprintf(stderr, "verifying %s failed\n", f.c_str());
+      return EXIT_FAILURE;
+    }
+    auto const rc = fs.read(std::get<littlefs::FileHandle>(file), back.data(), back.size());
+    (void)fs.close(std::get<littlefs::FileHandle>(file));
+    if (std::holds_alternative<littlefs::Error>(rc) || std::get<size_t>(rc) != data.size() || !std::equal(data.begin(), data.end(), back.begin())) {
+      fprintf(stderr, "verifying %s failed\n", f.c_str());
+      return EXIT_FAILURE;
+    }
+  }
+  (void)fs.unmount();
+  if (header_file && !write_header(header_file, image, dev.end, cfg.raw_cfg())) {
+    perror(header_file);
+    return EXIT_FAILURE;
+  }
+  image.close();
+
+  /* A file is contiguous if each of its blocks follows the previous one,
+   * a jump is a file starting somewhere else than after the previous file.
+   */
+  size_t with_blocks = 0, fragmented = 0, jumps = 0;
+  lfs_block_t next = 0;
+  for (auto const & b : blocks)
+  {
+    if (b.empty())
+      continue;
+    with_blocks++;
+    for (size_t i = 1; i < b.size(); i++)
+      if (b[i] != b[i - 1] + 1) {
+        fragmented++;
+        break;
+      }
+    jumps += (with_blocks > 1 && b.front() != next) ? 1 : 0;
+    next = b.back() + 1;
+  }
+
+  printf("%zu directories, %zu files, %zu bytes, %zu of %u blocks used\n",
+         dirs.size(), files.size(), bytes, std::holds_alternative<size_t>(used) ? std::get<size_t>(used) : 0, block_count);
+  printf("%zu files inlined, %zu of %zu files with data blocks fragmented, %zu jumps between files\n",
+         files.size() - with_blocks, fragmented, with_blocks, jumps);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,289 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host tool re-executing a trace captured by a TraceRecorder
+ * against a simulated flash device. The trace file holds the
+ * recorder's TraceRecords in chronological order, as written by
+ *
+ *   for (size_t i = 0; i < recorder.size(); i++)
+ *     Serial.write(reinterpret_cast<uint8_t const *>(&recorder[i]), sizeof(littlefs::TraceRecord));
+ *
+ * Paths are only known by their hash, so every path is replayed
+ * as a file or directory in the root directory named after its
+ * hash. Files and directories referenced before being created
+ * (the trace may start in the middle of a session) are created
+ * on first use. For each operation the recorded and simulated
+ * times are printed, which makes it possible to compare devices,
+ * configurations and library versions on the same workload.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/replay/replay.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o replay
+ *   ./replay trace.bin [nor|nand] [block count] [cache size]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#include <map>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/**************************************************************************************
+ * GLOBAL CONSTANTS
+ **************************************************************************************/
+
+static char const * const OP_NAME[] =
+{
+  "format", "mount", "unmount", "remove", "rename",
+  "open", "read", "write", "truncate", "tell", "size", "seek", "rewind", "sync", "close",
+  "mkdir", "dir_open", "dir_close", "dir_read", "dir_rewind", "dir_seek_name", "dir_entries",
+  "fs_size",
+  "read_mapped", "compact", "maintain", "consistency", "checkpoint", "alloc_seek",
+};
+static size_t constexpr OP_COUNT = sizeof(OP_NAME) / sizeof(OP_NAME[0]);
+static_assert(OP_COUNT == littlefs::TRACE_OP_COUNT, "OP_NAME must name every TraceOp");
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+struct OpStats
+{
+  uint32_t count;
+  uint32_t failed;
+  uint64_t recorded_us;
+  uint64_t simulated_us;
+};
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+class Replay
+{
+private:
+  littlefs::Filesystem & _fs;
+  std::map<uint32_t, littlefs::FileHandle> _file;
+  std::map<uint32_t, littlefs::DirHandle> _dir;
+  std::vector<uint8_t> _buf;
+
+  static std::string path(uint32_t const hash)
+  {
+    char name[16];
+    snprintf(name, sizeof(name), "h%08x", static_cast<unsigned>(hash));
+    return name;
+  }
+
+  template <typename T>
+  static bool failed(T const & res)
+  {
+    if constexpr (std::is_same_v<T, std::optional<littlefs::Error>>)
+      return res.has_value();
+    else
+      return std::holds_alternative<littlefs::Error>(res);
+  }
+
+public:
+  Replay(littlefs::Filesystem & fs) : _fs{fs} { }
+
+  /* Returns true if the operation failed in the replay. */
+  bool execute(littlefs::TraceRecord const & r)
+  {
+    using namespace littlefs;
+
+    auto const file = _file.find(r.id);
+    auto const dir  = _dir.find(r.id);
+
+    switch (static_cast<TraceOp>(r.op))
+    {
+    case TraceOp::FORMAT:      _file.clear(); _dir.clear(); return failed(_fs.format());
+    case TraceOp::MOUNT:       return failed(_fs.mount());
+    case TraceOp::UNMOUNT:     _file.clear(); _dir.clear(); return failed(_fs.unmount());
+    case TraceOp::REMOVE:      return failed(_fs.remove(path(r.id)));
+    case TraceOp::RENAME:      return failed(_fs.rename(path(r.id), path(r.arg)));
+    case TraceOp::MKDIR:       return failed(_fs.mkdir(path(r.id)));
+    case TraceOp::FS_SIZE:     return failed(_fs.fs_size());
+    case TraceOp::COMPACT:     return failed(_fs.compact());
+    case TraceOp::MAINTAIN:    return failed(_fs.maintain(r.arg));
+    case TraceOp::CONSISTENCY: return failed(_fs.consistency());
+    case TraceOp::CHECKPOINT:  return failed(_fs.checkpoint());
+    case TraceOp::ALLOC_SEEK:  return failed(_fs.alloc_seek(r.arg));
+
+    case TraceOp::OPEN:
+    {
+      if (r.result < 0)
+        return false;
+      /* The file may have been created before the trace starts. */
+      auto const fd = _fs.open(path(r.id), static_cast<OpenFlag>(r.arg | LFS_O_CREAT));
+      if (failed(fd))
+        return true;
+      _file[static_cast<uint32_t>(r.result)] = std::get<FileHandle>(fd);
+      return false;
+    }
+    case TraceOp::DIR_OPEN:
+    {
+      if (r.result < 0)
+        return false;
+      (void)_fs.mkdir(path(r.id));
+      auto const dd = _fs.dir_open(path(r.id));
+      if (failed(dd))
+        return true;
+      _dir[static_cast<uint32_t>(r.result)] = std::get<DirHandle>(dd);
+      return false;
+    }
+
+    default:
+      break;
+    }
+
+    switch (static_cast<TraceOp>(r.op))
+    {
+    case TraceOp::READ:
+    case TraceOp::READ_MAPPED:
+    case TraceOp::WRITE:
+    case TraceOp::TRUNCATE:
+    case TraceOp::TELL:
+    case TraceOp::SIZE:
+    case TraceOp::SEEK:
+    case TraceOp::REWIND:
+    case TraceOp::SYNC:
+    case TraceOp::CLOSE:
+      if (file == _file.end())
+        return true;
+      break;
+    default:
+      if (dir == _dir.end())
+        return true;
+      break;
+    }
+
+    switch (static_cast<TraceOp>(r.op))
+    {
+    case TraceOp::READ:
+      _buf.resize(r.arg);
+      return failed(_fs.read(file->second, _buf.data(), r.arg));
+    case TraceOp::READ_MAPPED:
+    {
+      auto const rc = _fs.read_mapped(file->second, r.arg);
+      return failed(rc) && std::get<Error>(rc) != Error::NOTSUP;
+    }
+    case TraceOp::WRITE:
+      _buf.assign(r.arg, 0x5A);
+      return failed(_fs.write(file->second, _buf.data(), r.arg));
+    case TraceOp::TRUNCATE: return failed(_fs.truncate(file->second, static_cast<int>(r.arg)));
+    case TraceOp::TELL:     return failed(_fs.tell(file->second));
+    case TraceOp::SIZE:     return failed(_fs.size(file->second));
+    case TraceOp::SEEK:     return failed(_fs.seek(file->second, static_cast<int>(r.arg), static_cast<WhenceFlag>(r.aux)));
+    case TraceOp::REWIND:   return failed(_fs.rewind(file->second));
+    case TraceOp::SYNC:     return failed(_fs.sync(file->second));
+    case TraceOp::CLOSE:
+    {
+      auto const fd = file->second;
+      _file.erase(file);
+      return failed(_fs.close(fd));
+    }
+    case TraceOp::DIR_CLOSE:
+    {
+      auto const dd = dir->second;
+      _dir.erase(dir);
+      return failed(_fs.dir_close(dd));
+    }
+    case TraceOp::DIR_READ:
+    {
+      std::string name;
+      Type type;
+      auto const rc = _fs.dir_read(dir->second, name, type);
+      return failed(rc) && std::get<Error>(rc) != Error::NOENT;
+    }
+    case TraceOp::DIR_REWIND:    return failed(_fs.dir_rewind(dir->second));
+    case TraceOp::DIR_SEEK_NAME: (void)_fs.dir_seek_name(dir->second, path(r.arg)); return false;
+    case TraceOp::DIR_ENTRIES:   return failed(_fs.dir_entries(dir->second, path(r.arg)));
+    default:                     return true;
+    }
+  }
+};
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s trace.bin [nor|nand] [block count] [cache size]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<littlefs::TraceRecord> trace;
+  if (FILE * f = fopen(argv[1], "rb"); f != nullptr) {
+    littlefs::TraceRecord r;
+    while (fread(&r, sizeof(r), 1, f) == 1)
+      trace.push_back(r);
+    fclose(f);
+  } else {
+    perror(argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  bool const is_nand = argc > 2 && std::string(argv[2]) == "nand";
+  littlefs::FlashTiming const timing = is_nand ? littlefs::SPI_NAND_FLASH : littlefs::SPI_NOR_FLASH;
+  lfs_size_t const block_size  = is_nand ? 128 * 1024 : 4096;
+  lfs_size_t const block_count = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : (is_nand ? 128 : 256);
+  lfs_size_t const cache_size  = argc > 4 ? std::strtoul(argv[4], nullptr, 0) : timing.page_size;
+
+  std::vector<uint8_t> mem(block_size * block_count, 0xFF);
+  littlefs::SimulatedFlashBlockDevice sim(mem.data(), block_size, block_count, timing);
+  littlefs::BlockDeviceConfig<littlefs::SimulatedFlashBlockDevice> cfg(sim, timing.page_size, timing.page_size, block_size, block_count, 500, cache_size, 16);
+  /* The simulated flash is in RAM, so mapped reads can be replayed as such. */
+  cfg.set_xip_base(mem.data(), mem.size());
+  littlefs::Filesystem fs(cfg);
+
+  /* A trace taken from a running system starts on a mounted filesystem. */
+  if (trace.empty() || (trace[0].op != static_cast<uint8_t>(littlefs::TraceOp::FORMAT) && trace[0].op != static_cast<uint8_t>(littlefs::TraceOp::MOUNT)))
+    if (fs.format() || fs.mount()) {
+      fprintf(stderr, "format/mount of the simulated device failed\n");
+      return EXIT_FAILURE;
+    }
+
+  Replay replay(fs);
+  std::array<OpStats, OP_COUNT> stats{};
+  for (auto const & r : trace)
+  {
+    if (r.op >= OP_COUNT)
+      continue;
+    OpStats & s = stats[r.op];
+    s.count++;
+    s.recorded_us += r.duration_us;
+    s.simulated_us += sim.measure([&] { s.failed += replay.execute(r) ? 1 : 0; });
+  }
+
+  printf("%zu records replayed\n\n", trace.size());
+  printf("%-14s %8s %7s %14s %14s %12s\n", "op", "count", "failed", "recorded us", "simulated us", "sim us/op");
+  uint64_t recorded_us = 0, simulated_us = 0;
+  for (size_t op = 0; op < OP_COUNT; op++)
+  {
+    OpStats const & s = stats[op];
+    if (!s.count)
+      continue;
+    printf("%-14s %8u %7u %14llu %14llu %12.1f\n", OP_NAME[op], s.count, s.failed,
+           static_cast<unsigned long long>(s.recorded_us), static_cast<unsigned long long>(s.simulated_us),
+           static_cast<double>(s.simulated_us) / s.count);
+    recorded_us += s.recorded_us;
+    simulated_us += s.simulated_us;
+  }
+  printf("%-14s %8s %7s %14llu %14llu\n", "total", "", "", static_cast<unsigned long long>(recorded_us), static_cast<unsigned long long>(simulated_us));
+
+  return EXIT_SUCCESS;
+}
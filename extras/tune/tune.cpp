@@ -0,0 +1,240 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+/* Host tool sweeping FilesystemConfig parameters for a simulated
+ * flash device. Every configuration runs the same workload, the
+ * Pareto front of RAM use vs. throughput vs. erase count is
+ * printed, followed by a FilesystemConfig initializer for the
+ * fastest configuration fitting into the given RAM budget.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DLFS_NO_DEBUG -c src/littlefs-v2.5.1/lfs.c src/littlefs-v2.5.1/lfs_util.c
+ *   g++ -std=c++17 -O2 -Isrc extras/tune/tune.cpp src/107-Arduino-littlefs.cpp lfs.o lfs_util.o -o tune
+ *   ./tune [nor|nand] [device size in KiB] [RAM budget in bytes]
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include <107-Arduino-littlefs.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+struct Params
+{
+  lfs_size_t read_size;
+  lfs_size_t prog_size;
+  lfs_size_t block_size;
+  lfs_size_t block_count;
+  int32_t    block_cycles;
+  lfs_size_t cache_size;
+  lfs_size_t lookahead_size;
+  lfs_size_t metadata_max;
+};
+
+struct Result
+{
+  Params params;
+  size_t ram;
+  double throughput;
+  uint32_t erases;
+  bool ok;
+};
+
+typedef littlefs::StatsBlockDevice<littlefs::SimulatedFlashBlockDevice> Device;
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+/* Representative workload: small configuration files rewritten
+ * over and over, an append-only log synced every few records and
+ * bulk files written once and read back. Returns the number of
+ * bytes transferred or 0 on error.
+ */
+static size_t workload(littlefs::Filesystem & fs)
+{
+  using namespace littlefs;
+
+  size_t bytes = 0;
+  std::vector<uint8_t> buf(8192, 0x5A);
+
+  auto const write_file = [&](std::string const & path, OpenFlag const flags, size_t const len) -> bool
+  {
+    auto const fd = fs.open(path, flags);
+    if (std::holds_alternative<Error>(fd)) return false;
+    auto const rc = fs.write(std::get<FileHandle>(fd), buf.data(), len);
+    if (fs.close(std::get<FileHandle>(fd)) || std::holds_alternative<Error>(rc)) return false;
+    bytes += len;
+    return true;
+  };
+
+  for (int r = 0; r < 20; r++)
+    for (int c = 0; c < 8; c++)
+      if (!write_file("cfg" + std::to_string(c), OpenFlag::WRONLY | OpenFlag::CREAT | OpenFlag::TRUNC, 200))
+        return 0;
+
+  auto const log = fs.open("log", OpenFlag::WRONLY | OpenFlag::CREAT | OpenFlag::APPEND);
+  if (std::holds_alternative<Error>(log)) return 0;
+  for (int r = 0; r < 2000; r++)
+  {
+    if (std::holds_alternative<Error>(fs.write(std::get<FileHandle>(log), buf.data(), 64))) return 0;
+    if ((r % 10) == 9 && fs.sync(std::get<FileHandle>(log))) return 0;
+    bytes += 64;
+  }
+  if (fs.close(std::get<FileHandle>(log))) return 0;
+
+  for (int f = 0; f < 16; f++)
+    if (!write_file("bulk" + std::to_string(f), OpenFlag::WRONLY | OpenFlag::CREAT, buf.size()))
+      return 0;
+  for (int f = 0; f < 16; f++)
+  {
+    auto const fd = fs.open("bulk" + std::to_string(f), OpenFlag::RDONLY);
+    if (std::holds_alternative<Error>(fd)) return 0;
+    auto const rc = fs.read(std::get<FileHandle>(fd), buf.data(), buf.size());
+    if (fs.close(std::get<FileHandle>(fd)) || std::holds_alternative<Error>(rc)) return 0;
+    bytes += buf.size();
+  }
+
+  return bytes;
+}
+
+static Result evaluate(Params const & p, littlefs::FlashTiming timing, lfs_size_t const erase_size)
+{
+  /* Logical blocks spanning several erase units are erased unit by unit. */
+  timing.block_erase_us *= p.block_size / erase_size;
+
+  std::vector<uint8_t> mem(p.block_size * p.block_count, 0xFF);
+  littlefs::SimulatedFlashBlockDevice sim(mem.data(), p.block_size, p.block_count, timing);
+  Device dev(sim);
+  littlefs::BlockDeviceConfig<Device> cfg(dev, p.read_size, p.prog_size, p.block_size, p.block_count, p.block_cycles, p.cache_size, p.lookahead_size);
+  cfg.set_metadata_max(p.metadata_max);
+
+  /* rcache + pcache + one open file cache + lookahead buffer. */
+  Result res{p, 3 * p.cache_size + p.lookahead_size, 0.0, 0, false};
+
+  littlefs::Filesystem fs(cfg);
+  if (fs.format() || fs.mount())
+    return res;
+
+  dev.reset();
+  uint64_t const start_us = sim.now_us();
+  size_t const bytes = workload(fs);
+  uint64_t const elapsed_us = sim.now_us() - start_us;
+  (void)fs.unmount();
+
+  res.ok = bytes > 0 && elapsed_us > 0;
+  res.throughput = res.ok ? static_cast<double>(bytes) / static_cast<double>(elapsed_us) * 1e6 / 1024.0 : 0.0;
+  res.erases = dev.stats().erases;
+  return res;
+}
+
+static bool dominates(Result const & a, Result const & b)
+{
+  bool const no_worse = a.ram <= b.ram && a.throughput >= b.throughput && a.erases <= b.erases;
+  bool const better   = a.ram <  b.ram || a.throughput >  b.throughput || a.erases <  b.erases;
+  return no_worse && better;
+}
+
+/**************************************************************************************
+ * MAIN
+ **************************************************************************************/
+
+int main(int argc, char ** argv)
+{
+  std::string const device     = argc > 1 ? argv[1] : "nor";
+  lfs_size_t  const size_kib   = argc > 2 ? std::strtoul(argv[2], nullptr, 0) : 1024;
+  size_t      const ram_budget = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : SIZE_MAX;
+
+  bool const is_nand = (device == "nand");
+  littlefs::FlashTiming const timing = is_nand ? littlefs::SPI_NAND_FLASH : littlefs::SPI_NOR_FLASH;
+  lfs_size_t const erase_size = is_nand ? 128 * 1024 : 4096;
+
+  std::vector<lfs_size_t> const io_sizes    = is_nand ? std::vector<lfs_size_t>{2048} : std::vector<lfs_size_t>{16, 64, 256};
+  std::vector<lfs_size_t> const block_sizes = {erase_size, 2 * erase_size, 4 * erase_size};
+  std::vector<lfs_size_t> const cache_sizes = {16, 64, 256, 512, 1024, 2048, 4096};
+  std::vector<lfs_size_t> const lookaheads  = {8, 32, 128};
+  std::vector<int32_t>    const cycles      = {100, 500};
+
+  std::vector<Result> results;
+  for (auto io : io_sizes)
+    for (auto bs : block_sizes)
+      for (auto cs : cache_sizes)
+        for (auto la : lookaheads)
+          for (auto bc : cycles)
+            for (auto mm : {lfs_size_t{0}, bs / 4})
+            {
+              if (cs < io || cs % io || bs % cs || (mm && mm < cs))
+                continue;
+              Params const p{io, io, bs, (size_kib * 1024) / bs, bc, cs, la, mm};
+              if (p.block_count < 16)
+                continue;
+              Result const r = evaluate(p, timing, erase_size);
+              if (r.ok)
+                results.push_back(r);
+            }
+
+  std::vector<Result> front;
+  for (auto const & r : results)
+    if (std::none_of(results.begin(), results.end(), [&r](Result const & o) { return dominates(o, r); }))
+      front.push_back(r);
+  std::stable_sort(front.begin(), front.end(), [](Result const & a, Result const & b)
+                   {
+                     if (a.ram != b.ram) return a.ram < b.ram;
+                     if (a.throughput != b.throughput) return a.throughput > b.throughput;
+                     return a.erases < b.erases;
+                   });
+  /* Of configurations performing identically only the first is listed. */
+  front.erase(std::unique(front.begin(), front.end(), [](Result const & a, Result const & b)
+              {
+                return a.ram == b.ram && a.throughput == b.throughput && a.erases == b.erases;
+              }), front.end());
+
+  printf("%zu configurations evaluated, Pareto front:\n\n", results.size());
+  printf("%6s %6s %8s %6s %6s %9s %6s %8s %10s %7s\n", "read", "prog", "block", "cache", "look", "cycles", "mdmax", "RAM", "KiB/s", "erases");
+  for (auto const & r : front)
+    printf("%6u %6u %8u %6u %6u %9d %6u %8zu %10.1f %7u\n",
+           r.params.read_size, r.params.prog_size, r.params.block_size, r.params.cache_size,
+           r.params.lookahead_size, r.params.block_cycles, r.params.metadata_max, r.ram, r.throughput, r.erases);
+
+  auto best = front.end();
+  for (auto it = front.begin(); it != front.end(); it++)
+    if (it->ram <= ram_budget && (best == front.end() || it->throughput > best->throughput))
+      best = it;
+  if (best == front.end()) {
+    printf("\nNo configuration fits into %zu bytes of RAM.\n", ram_budget);
+    return EXIT_FAILURE;
+  }
+
+  Params const & p = best->params;
+  printf("\nstatic littlefs::FilesystemConfig filesystem_config\n"
+         "  (\n"
+         "    read_func, prog_func, erase_func, sync_func,\n"
+         "    %u, /* read_size */\n"
+         "    %u, /* prog_size */\n"
+         "    %u, /* block_size */\n"
+         "    %u, /* block_count */\n"
+         "    %d, /* block_cycles */\n"
+         "    %u, /* cache_size */\n"
+         "    %u  /* lookahead_size */\n"
+         "  );\n",
+         p.read_size, p.prog_size, p.block_size, p.block_count, p.block_cycles, p.cache_size, p.lookahead_size);
+  if (p.metadata_max)
+    printf("filesystem_config.set_metadata_max(%u);\n", p.metadata_max);
+
+  return EXIT_SUCCESS;
+}
@@ -18,14 +18,160 @@
 namespace littlefs
 {
 
+/**************************************************************************************
+ * PRIVATE MEMBER FUNCTIONS
+ **************************************************************************************/
+
+bool DirRange::next()
+{
+  FilesystemLock const lock(_fs._cfg);
+
+  int const rc = _fs.trace(TraceOp::DIR_READ, _dd, 0, [&] { return lfs_dir_read(&_fs._lfs, _dir, &_info); });
+
+  // Note: lfs_dir_read returns false (0) when no more entries, true (1) on success,
+  // and possibly some lfs_error.
+  if (rc < LFS_ERR_OK)
+    _err = static_cast<Error>(rc);
+
+  if (rc <= 0)
+    return false;
+
+  // Entries are sorted, so all entries sharing the prefix are adjacent.
+  return (strncmp(_info.name, _prefix.c_str(), _prefix.size()) == 0);
+}
+
+void Executor::push(IoRequest * req)
+{
+  req->_next.store(nullptr, std::memory_order_relaxed);
+  IoRequest * prev = _head.exchange(req, std::memory_order_acq_rel);
+  prev->_next.store(req, std::memory_order_release);
+}
+
+IoRequest * Executor::pop()
+{
+  IoRequest * tail = _tail;
+  IoRequest * next = tail->_next.load(std::memory_order_acquire);
+
+  if (tail == &_stub)
+  {
+    if (next == nullptr)
+      return nullptr;
+    _tail = next;
+    tail = next;
+    next = next->_next.load(std::memory_order_acquire);
+  }
+
+  if (next != nullptr)
+  {
+    _tail = next;
+    return tail;
+  }
+
+  // A producer is in the middle of linking in a new request.
+  if (tail != _head.load(std::memory_order_acquire))
+    return nullptr;
+
+  push(&_stub);
+
+  next = tail->_next.load(std::memory_order_acquire);
+  if (next != nullptr)
+  {
+    _tail = next;
+    return tail;
+  }
+
+  return nullptr;
+}
+
+void Executor::complete(IoRequest & req)
+{
+  if (req._on_complete)
+    req._on_complete(req);
+
+  /* The submitter may release the request once it is done. */
+  void * const resume = req._resume ? req._user : nullptr;
+  req._done.store(true, std::memory_order_release);
+
+#ifdef LITTLEFS_HAS_COROUTINES
+  if (resume)
+    std::coroutine_handle<>::from_address(resume).resume();
+#else
+  (void)resume;
+#endif
+}
+
+int AsyncBlockDevice::wait()
+{
+  while (busy())
+  {
+    if (_poll)
+      _poll(*this);
+    if (_yield)
+      _yield();
+  }
+
+  return _err.load(std::memory_order_relaxed);
+}
+
 /**************************************************************************************
  * PUBLIC MEMBER FUNCTIONS
  **************************************************************************************/
 
+int AsyncBlockDevice::read(const struct lfs_config * c, lfs_block_t block, lfs_off_t off, void * buffer, lfs_size_t size)
+{
+  AsyncBlockDevice & dev = *static_cast<AsyncBlockDevice *>(c->context);
+
+  dev._busy.store(true, std::memory_order_relaxed);
+  if (auto const err = dev._read_submit(dev, block, off, buffer, size); err != LFS_ERR_OK)
+  {
+    dev._busy.store(false, std::memory_order_relaxed);
+    return err;
+  }
+
+  return dev.wait();
+}
+
+int AsyncBlockDevice::prog(const struct lfs_config * c, lfs_block_t block, lfs_off_t off, const void * buffer, lfs_size_t size)
+{
+  AsyncBlockDevice & dev = *static_cast<AsyncBlockDevice *>(c->context);
+
+  dev._busy.store(true, std::memory_order_relaxed);
+  if (auto const err = dev._prog_submit(dev, block, off, buffer, size); err != LFS_ERR_OK)
+  {
+    dev._busy.store(false, std::memory_order_relaxed);
+    return err;
+  }
+
+  return dev.wait();
+}
+
+int AsyncBlockDevice::erase(const struct lfs_config * c, lfs_block_t block)
+{
+  AsyncBlockDevice & dev = *static_cast<AsyncBlockDevice *>(c->context);
+
+  dev._busy.store(true, std::memory_order_relaxed);
+  if (auto const err = dev._erase_submit(dev, block); err != LFS_ERR_OK)
+  {
+    dev._busy.store(false, std::memory_order_relaxed);
+    return err;
+  }
+
+  return dev.wait();
+}
+
+int AsyncBlockDevice::sync(const struct lfs_config * c)
+{
+  // Every transfer has completed by the time its callback returns.
+  (void)c;
+  return LFS_ERR_OK;
+}
+
 #ifndef LFS_READONLY
 std::optional<Error> Filesystem::format()
 {
-  if (auto const err = lfs_format(&_lfs, &_cfg.raw_cfg()); err != LFS_ERR_OK)
+  FilesystemLock const lock(_cfg);
+
+  if (auto const err = trace(TraceOp::FORMAT, 0, 0, [&] { return lfs_format(&_lfs, &_cfg.raw_cfg()); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -34,7 +180,9 @@ std::optional<Error> Filesystem::format()
 
 std::optional<Error> Filesystem::mount()
 {
-  if (auto const err = lfs_mount(&_lfs, &_cfg.raw_cfg()); err != LFS_ERR_OK)
+  FilesystemLock const lock(_cfg);
+
+  if (auto const err = trace(TraceOp::MOUNT, 0, 0, [&] { return lfs_mount(&_lfs, &_cfg.raw_cfg()); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -42,7 +190,9 @@ std::optional<Error> Filesystem::mount()
 
 std::optional<Error> Filesystem::unmount()
 {
-  if (auto const err = lfs_unmount(&_lfs); err != LFS_ERR_OK)
+  FilesystemLock const lock(_cfg);
+
+  if (auto const err = trace(TraceOp::UNMOUNT, 0, 0, [&] { return lfs_unmount(&_lfs); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -51,7 +201,9 @@ std::optional<Error> Filesystem::unmount()
 #ifndef LFS_READONLY
 std::optional<Error> Filesystem::remove(std::string const & path)
 {
-  if (auto const err = lfs_remove(&_lfs, path.c_str()); err != LFS_ERR_OK)
+  FilesystemLock const lock(_cfg);
+
+  if (auto const err = trace(TraceOp::REMOVE, TraceRecorder::hash(path), 0, [&] { return lfs_remove(&_lfs, path.c_str()); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -59,7 +211,9 @@ std::optional<Error> Filesystem::remove(std::string const & path)
 
 std::optional<Error> Filesystem::rename(std::string const & old_path, std::string const & new_path)
 {
-  if (auto const err = lfs_rename(&_lfs, old_path.c_str(), new_path.c_str()); err != LFS_ERR_OK)
+  FilesystemLock const lock(_cfg);
+
+  if (auto const err = trace(TraceOp::RENAME, TraceRecorder::hash(old_path), TraceRecorder::hash(new_path), [&] { return lfs_rename(&_lfs, old_path.c_str(), new_path.c_str()); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -68,9 +222,15 @@ std::optional<Error> Filesystem::rename(std::string const & old_path, std::strin
 
 std::variant<Error, FileHandle> Filesystem::open(std::string const & path, OpenFlag const flags)
 {
+  FilesystemLock const lock(_cfg);
+
   auto file_hdl = std::make_shared<lfs_file_t>();
 
-  int const rc = lfs_file_open(&_lfs, file_hdl.get(), path.c_str(), static_cast<int>(flags));
+  int const rc = trace(TraceOp::OPEN, TraceRecorder::hash(path), static_cast<uint32_t>(flags), [&]
+                       {
+                         int const rc = lfs_file_open(&_lfs, file_hdl.get(), path.c_str(), static_cast<int>(flags));
+                         return (rc < LFS_ERR_OK) ? rc : static_cast<int>(_file_dsc_cnt);
+                       });
 
   if (rc < LFS_ERR_OK)
     return static_cast<Error>(rc);
@@ -81,11 +241,13 @@ std::variant<Error, FileHandle> Filesystem::open(std::string const & path, OpenF
 
 std::variant<Error, size_t> Filesystem::read(FileHandle const fd, void * read_buf, size_t const bytes_to_read)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  int const rc = lfs_file_read(&_lfs, iter->second.get(), read_buf, bytes_to_read);
+  int const rc = trace(TraceOp::READ, fd, bytes_to_read, [&] { return lfs_file_read(&_lfs, iter->second.get(), read_buf, bytes_to_read); });
 
   if (rc < LFS_ERR_OK)
     return static_cast<Error>(rc);
@@ -93,14 +255,65 @@ std::variant<Error, size_t> Filesystem::read(FileHandle const fd, void * read_bu
   return static_cast<size_t>(rc);
 }
 
+std::variant<Error, MappedData> Filesystem::read_mapped(FileHandle const fd, size_t const bytes_to_read)
+{
+  FilesystemLock const lock(_cfg);
+
+  auto iter = _file_desc_map.find(fd);
+  if (iter == _file_desc_map.end())
+    return Error::NO_FD_ENTRY;
+
+  if (!_cfg.xip_base())
+    return Error::INVAL;
+
+  uint8_t const * data = nullptr;
+  int const rc = trace(TraceOp::READ_MAPPED, fd, bytes_to_read, [&]
+  {
+    lfs_block_t block = 0;
+    lfs_off_t off = 0;
+    int const map_rc = lfs_file_mapread(&_lfs, iter->second.get(), &block, &off, bytes_to_read);
+    if (map_rc < LFS_ERR_OK)
+      return map_rc;
+
+    /* Inlined data is held in the file's cache, 'off' is relative to it. */
+    if (block == LFS_BLOCK_INLINE)
+    {
+      data = static_cast<uint8_t const *>(iter->second->cache.buffer) + off;
+      return map_rc;
+    }
+
+    /* Hand back what lies beyond the XIP window to read. */
+    size_t const pos = static_cast<size_t>(block) * _cfg.raw_cfg().block_size + off;
+    size_t const avail = (pos < _cfg.xip_size()) ? (_cfg.xip_size() - pos) : 0;
+    int const size = (avail < static_cast<size_t>(map_rc)) ? static_cast<int>(avail) : map_rc;
+    if (size < map_rc)
+    {
+      lfs_soff_t const seek_rc = lfs_file_seek(&_lfs, iter->second.get(), size - map_rc, LFS_SEEK_CUR);
+      if (seek_rc < LFS_ERR_OK)
+        return static_cast<int>(seek_rc);
+      if (!size)
+        return static_cast<int>(LFS_ERR_NOTSUP);
+    }
+    data = _cfg.xip_base() + pos;
+    return size;
+  });
+
+  if (rc < LFS_ERR_OK)
+    return static_cast<Error>(rc);
+
+  return MappedData{data, static_cast<size_t>(rc)};
+}
+
 #ifndef LFS_READONLY
 std::variant<Error, size_t> Filesystem::write(FileHandle const fd, void const * write_buf, size_t const bytes_to_write)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  int const rc = lfs_file_write(&_lfs, iter->second.get(), write_buf, bytes_to_write);
+  int const rc = trace(TraceOp::WRITE, fd, bytes_to_write, [&] { return lfs_file_write(&_lfs, iter->second.get(), write_buf, bytes_to_write); });
 
   if (rc < LFS_ERR_OK)
     return static_cast<Error>(rc);
@@ -112,11 +325,13 @@ std::variant<Error, size_t> Filesystem::write(FileHandle const fd, void const *
 #ifndef LFS_READONLY
 std::optional<Error> Filesystem::truncate(FileHandle const fd, int const size)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  if (auto const err = lfs_file_truncate(&_lfs, iter->second.get(), size); err != LFS_ERR_OK)
+  if (auto const err = trace(TraceOp::TRUNCATE, fd, size, [&] { return lfs_file_truncate(&_lfs, iter->second.get(), size); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -125,11 +340,13 @@ std::optional<Error> Filesystem::truncate(FileHandle const fd, int const size)
 
 std::variant<Error, size_t> Filesystem::tell(FileHandle const fd)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  int const rc = lfs_file_tell(&_lfs, iter->second.get());
+  int const rc = trace(TraceOp::TELL, fd, 0, [&] { return lfs_file_tell(&_lfs, iter->second.get()); });
 
   if (rc < LFS_ERR_OK)
     return static_cast<Error>(rc);
@@ -139,11 +356,13 @@ std::variant<Error, size_t> Filesystem::tell(FileHandle const fd)
 
 std::variant<Error, size_t> Filesystem::size(FileHandle const fd)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  int const rc = lfs_file_size(&_lfs, iter->second.get());
+  int const rc = trace(TraceOp::SIZE, fd, 0, [&] { return lfs_file_size(&_lfs, iter->second.get()); });
 
   if (rc < LFS_ERR_OK)
     return static_cast<Error>(rc);
@@ -153,11 +372,13 @@ std::variant<Error, size_t> Filesystem::size(FileHandle const fd)
 
 std::variant<Error, size_t> Filesystem::seek(FileHandle const fd, int const offset, WhenceFlag const whence)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  int const rc = lfs_file_seek(&_lfs, iter->second.get(), offset, static_cast<int>(whence));
+  int const rc = trace(TraceOp::SEEK, fd, offset, [&] { return lfs_file_seek(&_lfs, iter->second.get(), offset, static_cast<int>(whence)); }, static_cast<uint8_t>(whence));
 
   if (rc < LFS_ERR_OK)
     return static_cast<Error>(rc);
@@ -167,11 +388,13 @@ std::variant<Error, size_t> Filesystem::seek(FileHandle const fd, int const offs
 
 std::optional<Error> Filesystem::rewind(FileHandle const fd)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  if (auto const err = lfs_file_rewind(&_lfs, iter->second.get()); err != LFS_ERR_OK)
+  if (auto const err = trace(TraceOp::REWIND, fd, 0, [&] { return lfs_file_rewind(&_lfs, iter->second.get()); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -179,25 +402,33 @@ std::optional<Error> Filesystem::rewind(FileHandle const fd)
 
 std::optional<Error> Filesystem::sync(FileHandle const fd)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  if (auto const err = lfs_file_sync(&_lfs, iter->second.get()); err != LFS_ERR_OK)
+  /* Nothing to write out in a read-only build. */
+#ifndef LFS_READONLY
+  if (auto const err = trace(TraceOp::SYNC, fd, 0, [&] { return lfs_file_sync(&_lfs, iter->second.get()); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
+#endif
 
   return std::nullopt;
 }
 
 std::optional<Error> Filesystem::close(FileHandle const fd)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _file_desc_map.find(fd);
   if (iter == _file_desc_map.end())
     return Error::NO_FD_ENTRY;
 
-  _file_desc_map.erase(fd);
+  auto const err = trace(TraceOp::CLOSE, fd, 0, [&] { return lfs_file_close(&_lfs, iter->second.get()); });
+  _file_desc_map.erase(iter);
 
-  if (auto const err = lfs_file_close(&_lfs, iter->second.get()); err != LFS_ERR_OK)
+  if (err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -206,7 +437,9 @@ std::optional<Error> Filesystem::close(FileHandle const fd)
 #ifndef LFS_READONLY
 std::optional<Error> Filesystem::mkdir(std::string const & path)
 {
-  if (auto const err = lfs_mkdir(&_lfs, path.c_str()); err != LFS_ERR_OK)
+  FilesystemLock const lock(_cfg);
+
+  if (auto const err = trace(TraceOp::MKDIR, TraceRecorder::hash(path), 0, [&] { return lfs_mkdir(&_lfs, path.c_str()); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -215,9 +448,15 @@ std::optional<Error> Filesystem::mkdir(std::string const & path)
 
 std::variant<Error, DirHandle> Filesystem::dir_open(std::string const & path)
 {
+  FilesystemLock const lock(_cfg);
+
   auto dir_hdl = std::make_shared<lfs_dir_t>();
 
-  int const rc = lfs_dir_open(&_lfs, dir_hdl.get(), path.c_str());
+  int const rc = trace(TraceOp::DIR_OPEN, TraceRecorder::hash(path), 0, [&]
+                       {
+                         int const rc = lfs_dir_open(&_lfs, dir_hdl.get(), path.c_str());
+                         return (rc < LFS_ERR_OK) ? rc : static_cast<int>(_dir_dsc_cnt);
+                       });
 
   if (rc < LFS_ERR_OK)
     return static_cast<Error>(rc);
@@ -228,13 +467,16 @@ std::variant<Error, DirHandle> Filesystem::dir_open(std::string const & path)
 
 std::optional<Error> Filesystem::dir_close(DirHandle const dd)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _dir_desc_map.find(dd);
   if (iter == _dir_desc_map.end())
     return Error::NO_DD_ENTRY;
 
-  _dir_desc_map.erase(dd);
+  auto const err = trace(TraceOp::DIR_CLOSE, dd, 0, [&] { return lfs_dir_close(&_lfs, iter->second.get()); });
+  _dir_desc_map.erase(iter);
 
-  if (auto const err = lfs_dir_close(&_lfs, iter->second.get()); err != LFS_ERR_OK)
+  if (err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
@@ -242,12 +484,14 @@ std::optional<Error> Filesystem::dir_close(DirHandle const dd)
 
 std::variant<Error, size_t> Filesystem::dir_read(DirHandle const dd, std::string & name, Type & type)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _dir_desc_map.find(dd);
   if (iter == _dir_desc_map.end())
     return Error::NO_DD_ENTRY;
 
   lfs_info info;
-  int const rc = lfs_dir_read(&_lfs, iter->second.get(), &info);
+  int const rc = trace(TraceOp::DIR_READ, dd, 0, [&] { return lfs_dir_read(&_lfs, iter->second.get(), &info); });
 
   // Note: lfs_dir_read returns false (0) when no more entries, true (1) on success,
   // and possibly some lfs_error.
@@ -265,19 +509,69 @@ std::variant<Error, size_t> Filesystem::dir_read(DirHandle const dd, std::string
 
 std::optional<Error> Filesystem::dir_rewind(FileHandle const dd)
 {
+  FilesystemLock const lock(_cfg);
+
   auto iter = _dir_desc_map.find(dd);
   if (iter == _dir_desc_map.end())
     return Error::NO_DD_ENTRY;
 
-  if (auto const err = lfs_dir_rewind(&_lfs, iter->second.get()); err != LFS_ERR_OK)
+  if (auto const err = trace(TraceOp::DIR_REWIND, dd, 0, [&] { return lfs_dir_rewind(&_lfs, iter->second.get()); }); err != LFS_ERR_OK)
     return static_cast<Error>(err);
 
   return std::nullopt;
 }
 
+std::optional<Error> Filesystem::dir_seek_name(DirHandle const dd, std::string const & name)
+{
+  FilesystemLock const lock(_cfg);
+
+  auto iter = _dir_desc_map.find(dd);
+  if (iter == _dir_desc_map.end())
+    return Error::NO_DD_ENTRY;
+
+  // Note: lfs_dir_seekname returns false (0) when no entry with the given name exists,
+  // true (1) if it does, and possibly some lfs_error.
+  int const rc = trace(TraceOp::DIR_SEEK_NAME, dd, TraceRecorder::hash(name), [&] { return lfs_dir_seekname(&_lfs, iter->second.get(), name.c_str()); });
+
+  if (rc == 0)
+    return Error::NOENT;
+
+  if (rc < LFS_ERR_OK)
+    return static_cast<Error>(rc);
+
+  return std::nullopt;
+}
+
+std::variant<Error, DirRange> Filesystem::dir_entries(DirHandle const dd)
+{
+  FilesystemLock const lock(_cfg);
+
+  auto iter = _dir_desc_map.find(dd);
+  if (iter == _dir_desc_map.end())
+    return Error::NO_DD_ENTRY;
+
+  return DirRange(*this, dd, iter->second.get());
+}
+
+std::variant<Error, DirRange> Filesystem::dir_entries(DirHandle const dd, std::string const & prefix)
+{
+  FilesystemLock const lock(_cfg);
+
+  auto iter = _dir_desc_map.find(dd);
+  if (iter == _dir_desc_map.end())
+    return Error::NO_DD_ENTRY;
+
+  if (int const rc = trace(TraceOp::DIR_ENTRIES, dd, TraceRecorder::hash(prefix), [&] { return lfs_dir_seekprefix(&_lfs, iter->second.get(), prefix.c_str()); }); rc < LFS_ERR_OK)
+    return static_cast<Error>(rc);
+
+  return DirRange(*this, dd, iter->second.get(), prefix);
+}
+
 std::variant<Error, size_t> Filesystem::fs_size()
 {
-  int const rc = lfs_fs_size(&_lfs);
+  FilesystemLock const lock(_cfg);
+
+  int const rc = trace(TraceOp::FS_SIZE, 0, 0, [&] { return lfs_fs_size(&_lfs); });
 
   if (rc < LFS_ERR_OK)
     return static_cast<Error>(rc);
@@ -285,6 +579,165 @@ std::variant<Error, size_t> Filesystem::fs_size()
   return static_cast<size_t>(rc);
 }
 
+#ifndef LFS_READONLY
+std::variant<Error, bool> Filesystem::compact()
+{
+  FilesystemLock const lock(_cfg);
+
+  int const rc = trace(TraceOp::COMPACT, 0, 0, [&] { return lfs_fs_compact(&_lfs); });
+
+  if (rc < LFS_ERR_OK)
+    return static_cast<Error>(rc);
+
+  return rc > 0;
+}
+#endif
+
+#ifndef LFS_READONLY
+std::variant<Error, bool> Filesystem::maintain(size_t const budget)
+{
+  FilesystemLock const lock(_cfg);
+
+  int const rc = trace(TraceOp::MAINTAIN, 0, budget, [&]
+  {
+    size_t steps = 0;
+
+    while (steps < budget)
+    {
+      int const rc = lfs_fs_mkconsistent(&_lfs);
+      if (rc < LFS_ERR_OK)
+        return rc;
+      if (rc == 0)
+        break;
+      steps++;
+    }
+
+    if (steps < budget)
+    {
+      int const rc = lfs_fs_prealloc(&_lfs);
+      if (rc < LFS_ERR_OK)
+        return rc;
+      steps += rc;
+    }
+
+    while (steps < budget)
+    {
+      int const rc = lfs_fs_compact(&_lfs);
+      if (rc < LFS_ERR_OK)
+        return rc;
+      if (rc == 0)
+        return 0;
+      steps++;
+    }
+
+    return 1;
+  });
+
+  if (rc < LFS_ERR_OK)
+    return static_cast<Error>(rc);
+
+  return rc > 0;
+}
+#endif
+
+#ifndef LFS_READONLY
+std::variant<Error, Consistency> Filesystem::consistency()
+{
+  FilesystemLock const lock(_cfg);
+
+  lfs_fsconsistency consistency;
+  if (auto const err = trace(TraceOp::CONSISTENCY, 0, 0, [&] { return lfs_fs_consistency(&_lfs, &consistency); }); err != LFS_ERR_OK)
+    return static_cast<Error>(err);
+
+  return Consistency{consistency.move, consistency.orphans, consistency.checked, consistency.count};
+}
+#endif
+
+#ifndef LFS_READONLY
+std::optional<Error> Filesystem::checkpoint()
+{
+  FilesystemLock const lock(_cfg);
+
+  if (auto const err = trace(TraceOp::CHECKPOINT, 0, 0, [&] { return lfs_fs_checkpoint(&_lfs); }); err != LFS_ERR_OK)
+    return static_cast<Error>(err);
+
+  return std::nullopt;
+}
+#endif
+
+#ifndef LFS_READONLY
+std::optional<Error> Filesystem::alloc_seek(lfs_block_t const block)
+{
+  FilesystemLock const lock(_cfg);
+
+  if (auto const err = trace(TraceOp::ALLOC_SEEK, 0, block, [&] { return lfs_fs_allocseek(&_lfs, block); }); err != LFS_ERR_OK)
+    return static_cast<Error>(err);
+
+  return std::nullopt;
+}
+#endif
+
+void Executor::submit(IoRequest & req)
+{
+  req._done.store(false, std::memory_order_relaxed);
+  req._batch_next = nullptr;
+  push(&req);
+}
+
+size_t Executor::process(size_t const max_requests)
+{
+  size_t cnt = 0;
+  IoRequest * syncs = nullptr;
+  IoRequest ** syncs_tail = &syncs;
+
+  for (IoRequest * req = nullptr; (cnt < max_requests) && (req = pop()) != nullptr; cnt++)
+  {
+    switch (req->_op)
+    {
+      case IoRequest::Op::READ:
+        req->_result = _fs.read(req->_fd, req->_read_buf, req->_len);
+        complete(*req);
+        break;
+#ifndef LFS_READONLY
+      case IoRequest::Op::WRITE:
+        req->_result = _fs.write(req->_fd, req->_write_buf, req->_len);
+        complete(*req);
+        break;
+#endif
+      default:
+        *syncs_tail = req;
+        syncs_tail = &req->_batch_next;
+        break;
+    }
+  }
+
+  // Sync each file once, sync requests for an already synced file share its result.
+  for (IoRequest * req = syncs; req != nullptr; req = req->_batch_next)
+  {
+    IoRequest * prev = syncs;
+    while (prev != req && prev->_fd != req->_fd)
+      prev = prev->_batch_next;
+
+    if (prev != req) {
+      req->_result = prev->_result;
+    } else if (auto const err = _fs.sync(req->_fd); err.has_value()) {
+      req->_result = err.value();
+    } else {
+      req->_result = size_t{0};
+    }
+  }
+
+  // The submitter may release a request as soon as it is done, so grab the next one first.
+  for (IoRequest * req = syncs; req != nullptr; )
+  {
+    IoRequest * next = req->_batch_next;
+    complete(*req);
+    req = next;
+  }
+
+  return cnt;
+}
+
 /**************************************************************************************
  * NAMESPACE
  **************************************************************************************/
@@ -14,12 +14,32 @@
 
 #include "littlefs-v2.5.1/lfs.h"
 
+#include "blockdevice/FlashTiming.h"
+#include "blockdevice/CachedBlockDevice.h"
+#include "blockdevice/StatsBlockDevice.h"
+#include "blockdevice/LatencyBlockDevice.h"
+#include "blockdevice/FaultInjectionBlockDevice.h"
+#include "blockdevice/SimulatedFlashBlockDevice.h"
+#include "blockdevice/BlankCheckBlockDevice.h"
+#include "blockdevice/RomBlockDevice.h"
+
 #include <map>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
 #include <memory>
 #include <string>
+#include <utility>
 #include <variant>
+#include <type_traits>
+#include <string_view>
 #include <optional>
 
+#if defined(__cpp_impl_coroutine) && (__cpp_impl_coroutine >= 201902L)
+# include <coroutine>
+# define LITTLEFS_HAS_COROUTINES 1
+#endif
+
 /**************************************************************************************
  * NAMESPACE
  **************************************************************************************/
@@ -67,6 +87,7 @@ enum class Error : int
   NOMEM       = LFS_ERR_NOMEM,
   NOATTR      = LFS_ERR_NOATTR,
   NAMETOOLONG = LFS_ERR_NAMETOOLONG,
+  NOTSUP      = LFS_ERR_NOTSUP,
   NO_FD_ENTRY = -50,                 // No entry found for given file descriptor
   NO_DD_ENTRY = -51,                 // No entry found for given directory descriptor
 };
@@ -80,6 +101,60 @@ enum class Type : int
 typedef size_t FileHandle;
 typedef size_t DirHandle;
 
+enum class TraceOp : uint8_t
+{
+  FORMAT, MOUNT, UNMOUNT, REMOVE, RENAME,
+  OPEN, READ, WRITE, TRUNCATE, TELL, SIZE, SEEK, REWIND, SYNC, CLOSE,
+  MKDIR, DIR_OPEN, DIR_CLOSE, DIR_READ, DIR_REWIND, DIR_SEEK_NAME, DIR_ENTRIES,
+  FS_SIZE,
+  READ_MAPPED, COMPACT, MAINTAIN, CONSISTENCY, CHECKPOINT, ALLOC_SEEK,
+};
+
+static size_t constexpr TRACE_OP_COUNT = static_cast<size_t>(TraceOp::ALLOC_SEEK) + 1;
+
+/* One recorded Filesystem call. 'id' is the file/directory handle
+ * or, for calls taking a path, its TraceRecorder::hash. 'arg' is
+ * the transfer size, offset, open flags, maintain budget, block
+ * (for alloc_seek) or (for rename) the hash of the new path.
+ * 'result' is the lfs return value, for open and dir_open the
+ * handle assigned on success, for read_mapped the size mapped and
+ * for compact and maintain 1 if work is left. The layout is identical
+ * on all little-endian targets, so a ring buffer can be dumped
+ * verbatim and replayed on the host.
+ */
+struct TraceRecord
+{
+  uint32_t start_us;
+  uint32_t duration_us;
+  uint32_t id;
+  uint32_t arg;
+  int32_t  result;
+  uint8_t  op;
+  uint8_t  aux;
+  uint16_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord layout must not depend on the target");
+
+/* File data located in place by Filesystem::read_mapped. */
+struct MappedData
+{
+  uint8_t const * data;
+  size_t size;
+};
+
+/* Progress of resolving what a power loss left behind, see
+ * Filesystem::consistency. 'checked' of 'count' metadata pairs
+ * have been searched for orphans so far, 'count' is 0 if mount
+ * did not scan them (checkpoint or retained state).
+ */
+struct Consistency
+{
+  bool   move;     /* A move interrupted by a power loss is pending. */
+  size_t orphans;  /* Orphans recorded in the global state. */
+  size_t checked;
+  size_t count;
+};
+
 /**************************************************************************************
  * CLASS DECLARATION
  **************************************************************************************/
@@ -94,6 +169,17 @@ public:
   typedef int (*ProgFuncPtr)(const struct lfs_config *, lfs_block_t, lfs_off_t, const void *, lfs_size_t);
   typedef int (*EraseFuncPtr)(const struct lfs_config *, lfs_block_t);
   typedef int (*SyncFuncPtr)(const struct lfs_config *);
+  typedef int (*EraseRangeFuncPtr)(const struct lfs_config *, lfs_block_t, lfs_size_t);
+  typedef int (*LockFuncPtr)(const struct lfs_config *);
+  typedef int (*UnlockFuncPtr)(const struct lfs_config *);
+
+private:
+  LockFuncPtr _lock;
+  UnlockFuncPtr _unlock;
+  uint8_t const * _xip_base;
+  size_t _xip_size;
+
+public:
 
   FilesystemConfig(ReadFuncPtr  read_func,
                    ProgFuncPtr  prog_func,
@@ -106,6 +192,10 @@ public:
                    int32_t    const block_cycles,
                    lfs_size_t const cache_size,
                    lfs_size_t const lookahead_size)
+  : _lock{nullptr}
+  , _unlock{nullptr}
+  , _xip_base{nullptr}
+  , _xip_size{0}
   {
     memset(&_cfg, 0, sizeof(_cfg));
 
@@ -121,11 +211,471 @@ public:
     _cfg.block_cycles   = block_cycles;
     _cfg.cache_size     = cache_size;
     _cfg.lookahead_size = lookahead_size;
+
+#ifdef LFS_THREADSAFE
+    _cfg.lock   = +[](const struct lfs_config *) -> int { return LFS_ERR_OK; };
+    _cfg.unlock = +[](const struct lfs_config *) -> int { return LFS_ERR_OK; };
+#endif
+  }
+
+  /* Installs a user-supplied mutex which serializes all calls
+   * into a Filesystem using this configuration. If the library
+   * is compiled with LFS_THREADSAFE the hooks are also handed to
+   * littlefs, which then takes them again from within the calls,
+   * so the mutex must be recursive in that case.
+   */
+  void set_lock(LockFuncPtr lock_func, UnlockFuncPtr unlock_func)
+  {
+    _lock   = lock_func;
+    _unlock = unlock_func;
+#ifdef LFS_THREADSAFE
+    _cfg.lock   = lock_func;
+    _cfg.unlock = unlock_func;
+#endif
+  }
+
+  void lock  () { if (_lock)   (void)_lock(&_cfg); }
+  void unlock() { if (_unlock) (void)_unlock(&_cfg); }
+
+  void set_context(void * context) { _cfg.context = context; }
+
+  /* Keeps a summary of up to 'size' metadata pairs in RAM,
+   * which lets name lookups in large directories step over
+   * metadata pairs without fetching them from the device.
+   */
+  void set_dircache(lfs_size_t const size, lfs_dircache_t * buffer = nullptr)
+  {
+    _cfg.dircache_size   = size;
+    _cfg.dircache_buffer = buffer;
+  }
+
+  /* Limits the size of metadata pairs to less than a block,
+   * bounding the time spent compacting them. 0 uses block_size.
+   */
+  void set_metadata_max(lfs_size_t const metadata_max) { _cfg.metadata_max = metadata_max; }
+
+  /* Fill level above which Filesystem::compact compacts a
+   * metadata pair. 0 uses 3/4 of metadata_max (or block_size),
+   * otherwise it must be above half of it and at most all of it,
+   * which is asserted on mount.
+   */
+  void set_compact_thresh(lfs_size_t const compact_thresh) { _cfg.compact_thresh = compact_thresh; }
+
+  /* Writes a mount checkpoint on every unmount, see
+   * Filesystem::checkpoint.
+   */
+  void set_mount_checkpoint(bool const enable) { _cfg.mount_checkpoint = enable; }
+
+  /* Keeps the mounted state in a buffer of LFS_RETAINED_SIZE(lookahead_size)
+   * bytes which survives soft resets, e.g. in a .noinit section. As long as
+   * it is valid Filesystem::mount resumes from it without scanning the
+   * device. Clear it if the device is modified by other means. The buffer
+   * holds 32-bit words and must be 4-byte aligned, e.g. via alignas(4).
+   */
+  void set_retained(void * buffer)
+  {
+    LFS_ASSERT(reinterpret_cast<uintptr_t>(buffer) % 4 == 0);
+    _cfg.retained_buffer = buffer;
   }
 
+  /* Erases 'count' consecutive blocks at once, e.g. using 64 KiB
+   * sector or chip erase. Used by format to blank the device and
+   * by the allocator to erase the free blocks a file write is
+   * about to fill in one go.
+   */
+  void set_erase_range(EraseRangeFuncPtr erase_range_func) { _cfg.erase_range = erase_range_func; }
+
+  /* Address at which block 0 of the device appears in memory, e.g.
+   * the XIP window of a QSPI flash, enabling Filesystem::read_mapped.
+   * Data beyond the first 'size' bytes is never mapped, e.g. the
+   * erased tail left out of a RomBlockDevice image.
+   */
+  void set_xip_base(void const * base, size_t const size = SIZE_MAX) { _xip_base = static_cast<uint8_t const *>(base); _xip_size = size; }
+  [[nodiscard]] uint8_t const * xip_base() const { return _xip_base; }
+  [[nodiscard]] size_t          xip_size() const { return _xip_size; }
+
   [[nodiscard]] lfs_config & raw_cfg() { return _cfg; }
 };
 
+template <typename BlockDevice, typename = void>
+struct has_erase_range : std::false_type { };
+template <typename BlockDevice>
+struct has_erase_range<BlockDevice, std::void_t<decltype(std::declval<BlockDevice &>().erase_range(lfs_block_t{}, lfs_size_t{}))>> : std::true_type { };
+
+/* FilesystemConfig for any type modelling a block device, i.e.
+ * providing the member functions
+ *
+ *   int read (lfs_block_t block, lfs_off_t off, void * buffer, lfs_size_t size);
+ *   int prog (lfs_block_t block, lfs_off_t off, const void * buffer, lfs_size_t size);
+ *   int erase(lfs_block_t block);
+ *   int sync ();
+ *
+ * and optionally
+ *
+ *   int erase_range(lfs_block_t block, lfs_size_t count);
+ *
+ * returning LFS_ERR_OK or a negative lfs_error. The device is
+ * passed via lfs_config::context, so several instances can be
+ * used side by side, and the member functions can be inlined
+ * into the callbacks invoked by littlefs.
+ */
+template <typename BlockDevice>
+class BlockDeviceConfig : public FilesystemConfig
+{
+private:
+  static BlockDevice & dev(const struct lfs_config * c) { return *static_cast<BlockDevice *>(c->context); }
+
+  static int read (const struct lfs_config * c, lfs_block_t block, lfs_off_t off, void * buffer, lfs_size_t size)       { return dev(c).read(block, off, buffer, size); }
+  static int prog (const struct lfs_config * c, lfs_block_t block, lfs_off_t off, const void * buffer, lfs_size_t size) { return dev(c).prog(block, off, buffer, size); }
+  static int erase(const struct lfs_config * c, lfs_block_t block)                                                      { return dev(c).erase(block); }
+  static int sync (const struct lfs_config * c)                                                                         { return dev(c).sync(); }
+  static int erase_range(const struct lfs_config * c, lfs_block_t block, lfs_size_t count)                              { return dev(c).erase_range(block, count); }
+
+public:
+  BlockDeviceConfig(BlockDevice & block_device,
+                    lfs_size_t const read_size,
+                    lfs_size_t const prog_size,
+                    lfs_size_t const block_size,
+                    lfs_size_t const block_count,
+                    int32_t    const block_cycles,
+                    lfs_size_t const cache_size,
+                    lfs_size_t const lookahead_size)
+  : FilesystemConfig(read, prog, erase, sync, read_size, prog_size, block_size, block_count, block_cycles, cache_size, lookahead_size)
+  {
+    set_context(&block_device);
+    if constexpr (has_erase_range<BlockDevice>::value)
+      set_erase_range(erase_range);
+  }
+};
+
+/* Block device backed by a caller-provided RAM buffer of
+ * block_size * block_count bytes, e.g. for a RAM disk or
+ * for exercising a configuration on the host.
+ */
+class RamBlockDevice
+{
+private:
+  uint8_t * _buf;
+  lfs_size_t const _block_size;
+  lfs_size_t const _block_count;
+
+public:
+  RamBlockDevice(uint8_t * buf, lfs_size_t const block_size, lfs_size_t const block_count)
+  : _buf{buf}
+  , _block_size{block_size}
+  , _block_count{block_count}
+  { }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    memcpy(buffer, _buf + (block * _block_size) + off, size);
+    return LFS_ERR_OK;
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    memcpy(_buf + (block * _block_size) + off, buffer, size);
+    return LFS_ERR_OK;
+  }
+  int erase(lfs_block_t const block)
+  {
+    memset(_buf + (block * _block_size), 0xFF, _block_size);
+    return LFS_ERR_OK;
+  }
+  int sync()
+  {
+    return LFS_ERR_OK;
+  }
+
+  [[nodiscard]] lfs_size_t block_size () const { return _block_size; }
+  [[nodiscard]] lfs_size_t block_count() const { return _block_count; }
+};
+
+/* Adapts a block device with non-blocking transfers (e.g. DMA
+ * driven SPI/QSPI) to the synchronous callbacks of littlefs. A
+ * transfer is started via the submit functions, the driver calls
+ * complete() once it has finished (typically from its interrupt
+ * handler). While a transfer is in flight the optional poll
+ * function (for drivers without a completion interrupt) and the
+ * yield function are invoked, so a cooperative scheduler keeps
+ * running other work until littlefs resumes. Pass the static
+ * read/prog/erase/sync functions to FilesystemConfig and the
+ * AsyncBlockDevice via FilesystemConfig::set_context.
+ */
+class AsyncBlockDevice
+{
+public:
+  typedef int  (*ReadSubmitFuncPtr) (AsyncBlockDevice &, lfs_block_t, lfs_off_t, void *, lfs_size_t);
+  typedef int  (*ProgSubmitFuncPtr) (AsyncBlockDevice &, lfs_block_t, lfs_off_t, const void *, lfs_size_t);
+  typedef int  (*EraseSubmitFuncPtr)(AsyncBlockDevice &, lfs_block_t);
+  typedef void (*PollFuncPtr)       (AsyncBlockDevice &);
+  typedef void (*YieldFuncPtr)      ();
+
+private:
+  ReadSubmitFuncPtr _read_submit;
+  ProgSubmitFuncPtr _prog_submit;
+  EraseSubmitFuncPtr _erase_submit;
+  PollFuncPtr _poll;
+  YieldFuncPtr _yield;
+  void * _context;
+  std::atomic<bool> _busy;
+  std::atomic<int> _err;
+
+  int wait();
+
+public:
+  AsyncBlockDevice(ReadSubmitFuncPtr  read_submit,
+                   ProgSubmitFuncPtr  prog_submit,
+                   EraseSubmitFuncPtr erase_submit,
+                   PollFuncPtr        poll_func,
+                   YieldFuncPtr       yield_func,
+                   void *             context = nullptr)
+  : _read_submit{read_submit}
+  , _prog_submit{prog_submit}
+  , _erase_submit{erase_submit}
+  , _poll{poll_func}
+  , _yield{yield_func}
+  , _context{context}
+  , _busy{false}
+  , _err{LFS_ERR_OK}
+  { }
+
+  AsyncBlockDevice(AsyncBlockDevice const &) = delete;
+  AsyncBlockDevice & operator = (AsyncBlockDevice const &) = delete;
+
+  void   complete(int const err) { _err.store(err, std::memory_order_relaxed); _busy.store(false, std::memory_order_release); }
+  bool   busy   () const         { return _busy.load(std::memory_order_acquire); }
+  void * context() const         { return _context; }
+
+  static int read (const struct lfs_config * c, lfs_block_t block, lfs_off_t off, void * buffer, lfs_size_t size);
+  static int prog (const struct lfs_config * c, lfs_block_t block, lfs_off_t off, const void * buffer, lfs_size_t size);
+  static int erase(const struct lfs_config * c, lfs_block_t block);
+  static int sync (const struct lfs_config * c);
+};
+
+/* Ring buffer of TraceRecords filled by a Filesystem once
+ * installed via Filesystem::set_recorder. When full the oldest
+ * record is overwritten. The clock (e.g. micros()) is optional,
+ * without it no timing is recorded.
+ */
+class TraceRecorder
+{
+public:
+  typedef uint32_t (*ClockFuncPtr)();
+
+private:
+  TraceRecord * _buf;
+  size_t const _capacity;
+  ClockFuncPtr _clock;
+  size_t _head;
+  size_t _size;
+  uint32_t _overwritten;
+
+public:
+  TraceRecorder(TraceRecord * buf, size_t const capacity, ClockFuncPtr clock = nullptr)
+  : _buf{buf}
+  , _capacity{capacity}
+  , _clock{clock}
+  , _head{0}
+  , _size{0}
+  , _overwritten{0}
+  { }
+
+  /* FNV-1a */
+  static uint32_t hash(std::string const & path)
+  {
+    uint32_t h = 2166136261UL;
+    for (char const c : path)
+      h = (h ^ static_cast<uint8_t>(c)) * 16777619UL;
+    return h;
+  }
+
+  uint32_t now() const { return _clock ? _clock() : 0; }
+
+  void record(TraceOp const op, uint32_t const id, uint32_t const arg, uint8_t const aux, uint32_t const start_us, int32_t const result)
+  {
+    if (!_capacity)
+      return;
+    _buf[_head] = TraceRecord{start_us, now() - start_us, id, arg, result, static_cast<uint8_t>(op), aux, 0};
+    _head = (_head + 1) % _capacity;
+    if (_size < _capacity)
+      _size++;
+    else
+      _overwritten++;
+  }
+
+  void clear() { _head = 0; _size = 0; _overwritten = 0; }
+
+  /* Records in chronological order, 0 being the oldest. */
+  [[nodiscard]] TraceRecord const & operator [] (size_t const idx) const { return _buf[(_head + _capacity - _size + idx) % _capacity]; }
+  [[nodiscard]] size_t size() const { return _size; }
+  [[nodiscard]] uint32_t overwritten() const { return _overwritten; }
+};
+
+/* Latency histogram with logarithmic buckets: bucket 0 counts
+ * calls taking less than 1 us, bucket i > 0 those taking
+ * [2^(i-1), 2^i) us, the last bucket also everything longer.
+ */
+class LatencyHistogram
+{
+public:
+  static size_t constexpr BUCKETS = 32;
+
+private:
+  uint32_t _bucket[BUCKETS];
+  uint32_t _count;
+  uint32_t _max_us;
+  uint64_t _sum_us;
+
+public:
+  LatencyHistogram() { reset(); }
+
+  static size_t bucket_of(uint32_t us)
+  {
+    size_t b = 0;
+    for (; us && b < BUCKETS - 1; us >>= 1)
+      b++;
+    return b;
+  }
+  /* Smallest latency not counted in bucket b anymore. */
+  static uint64_t bucket_limit_us(size_t const b) { return uint64_t{1} << b; }
+
+  void add(uint32_t const us)
+  {
+    _bucket[bucket_of(us)]++;
+    _count++;
+    _sum_us += us;
+    if (us > _max_us)
+      _max_us = us;
+  }
+  void reset()
+  {
+    for (auto & b : _bucket) b = 0;
+    _count = 0;
+    _max_us = 0;
+    _sum_us = 0;
+  }
+
+  /* Upper bound of the bucket holding the given percentile (0 - 100),
+   * limited to the longest latency seen.
+   */
+  [[nodiscard]] uint64_t percentile_us(uint32_t const percent) const
+  {
+    uint64_t const rank = (static_cast<uint64_t>(_count) * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < BUCKETS; b++)
+      if ((seen += _bucket[b]) >= rank && seen > 0)
+        return bucket_limit_us(b) < _max_us ? bucket_limit_us(b) : _max_us;
+    return 0;
+  }
+
+  [[nodiscard]] uint32_t bucket(size_t const b) const { return b < BUCKETS ? _bucket[b] : 0; }
+  [[nodiscard]] uint32_t count() const { return _count; }
+  [[nodiscard]] uint32_t max_us() const { return _max_us; }
+  [[nodiscard]] uint32_t mean_us() const { return _count ? static_cast<uint32_t>(_sum_us / _count) : 0; }
+};
+
+/* One LatencyHistogram per TraceOp, filled by a Filesystem once
+ * installed via Filesystem::set_latency_monitor. The clock (e.g.
+ * micros()) is supplied by the user.
+ */
+class LatencyMonitor
+{
+public:
+  typedef uint32_t (*ClockFuncPtr)();
+
+private:
+  ClockFuncPtr _clock;
+  LatencyHistogram _hist[TRACE_OP_COUNT];
+
+public:
+  LatencyMonitor(ClockFuncPtr clock) : _clock{clock} { }
+
+  uint32_t now() const { return _clock(); }
+  void add(TraceOp const op, uint32_t const us) { _hist[static_cast<size_t>(op)].add(us); }
+  void reset() { for (auto & h : _hist) h.reset(); }
+
+  [[nodiscard]] LatencyHistogram const & histogram(TraceOp const op) const { return _hist[static_cast<size_t>(op)]; }
+};
+
+class FilesystemLock
+{
+private:
+  FilesystemConfig & _cfg;
+public:
+  FilesystemLock(FilesystemConfig & cfg) : _cfg{cfg} { _cfg.lock(); }
+  ~FilesystemLock() { _cfg.unlock(); }
+  FilesystemLock(FilesystemLock const &) = delete;
+  FilesystemLock & operator = (FilesystemLock const &) = delete;
+};
+
+/* Lightweight view of a single directory entry. It refers to
+ * the lfs_info buffer owned by a DirRange and is only valid
+ * until the iterator it was obtained from is advanced.
+ */
+class DirEntry
+{
+private:
+  lfs_info const & _info;
+public:
+  DirEntry(lfs_info const & info) : _info{info} { }
+
+  std::string_view name() const { return std::string_view(_info.name); }
+  Type             type() const { return static_cast<Type>(_info.type); }
+  size_t           size() const { return type() == Type::REG ? static_cast<size_t>(_info.size) : 0; }
+};
+
+/* Single-pass range over the entries of an open directory,
+ * obtained via Filesystem::dir_entries. A single lfs_info is
+ * reused for all entries, so no heap allocation takes place
+ * while iterating. Iteration stops at the end of the directory,
+ * at the first entry not starting with the (optional) prefix
+ * or at the first error, which can be queried via error().
+ * Every entry read is traced as DIR_READ of the directory handle.
+ * The range is invalidated by closing the directory handle.
+ */
+class Filesystem;
+
+class DirRange
+{
+private:
+  Filesystem & _fs;
+  DirHandle const _dd;
+  lfs_dir_t * _dir;
+  lfs_info _info;
+  std::string _prefix;
+  std::optional<Error> _err;
+
+  bool next();
+
+public:
+  class Iterator
+  {
+  private:
+    DirRange * _range;
+  public:
+    Iterator(DirRange * range) : _range{range} { }
+
+    DirEntry   operator * () const { return DirEntry(_range->_info); }
+    Iterator & operator ++ ()      { if (!_range->next()) _range = nullptr; return *this; }
+    bool       operator != (Iterator const & other) const { return _range != other._range; }
+  };
+
+  DirRange(Filesystem & fs, DirHandle const dd, lfs_dir_t * dir, std::string const & prefix = "")
+  : _fs{fs}
+  , _dd{dd}
+  , _dir{dir}
+  , _prefix{prefix}
+  , _err{std::nullopt}
+  {
+    memset(&_info, 0, sizeof(_info));
+  }
+
+  Iterator begin() { return Iterator(next() ? this : nullptr); }
+  Iterator end()   { return Iterator(nullptr); }
+
+  [[nodiscard]] std::optional<Error> error() const { return _err; }
+};
+
 class Filesystem
 {
 private:
@@ -135,15 +685,62 @@ private:
   std::map<size_t, std::shared_ptr<lfs_file_t>> _file_desc_map;
   size_t _dir_dsc_cnt;
   std::map<size_t, std::shared_ptr<lfs_dir_t>> _dir_desc_map;
+  TraceRecorder * _recorder;
+  LatencyMonitor * _monitor;
+
+  friend class DirRange;
+
+  template <typename Func>
+  int trace(TraceOp const op, uint32_t const id, uint32_t const arg, Func && func, uint8_t const aux = 0)
+  {
+    if (!_recorder && !_monitor)
+      return func();
+    uint32_t const start_us = _recorder ? _recorder->now() : 0;
+    uint32_t const monitor_start_us = _monitor ? _monitor->now() : 0;
+    int const rc = func();
+    if (_monitor)
+      _monitor->add(op, _monitor->now() - monitor_start_us);
+    if (_recorder)
+      _recorder->record(op, id, arg, aux, start_us, rc);
+    return rc;
+  }
+
 public:
   Filesystem(FilesystemConfig & cfg)
   : _cfg{cfg}
   , _file_dsc_cnt{0}
   , _dir_dsc_cnt{0}
+  , _recorder{nullptr}
+  , _monitor{nullptr}
   {
     memset(&_lfs, 0, sizeof(_lfs));
   }
 
+  /* Records every call reaching littlefs, pass nullptr to stop. */
+  void set_recorder(TraceRecorder * recorder)
+  {
+    FilesystemLock const lock(_cfg);
+    _recorder = recorder;
+  }
+
+  /* Collects per-operation latency histograms, pass nullptr to stop. */
+  void set_latency_monitor(LatencyMonitor * monitor)
+  {
+    FilesystemLock const lock(_cfg);
+    _monitor = monitor;
+  }
+
+  /* Snapshot of the latency histogram of the given operation,
+   * std::nullopt if no LatencyMonitor is installed.
+   */
+  [[nodiscard]] std::optional<LatencyHistogram> latency(TraceOp const op)
+  {
+    FilesystemLock const lock(_cfg);
+    if (!_monitor)
+      return std::nullopt;
+    return _monitor->histogram(op);
+  }
+
 #ifndef LFS_READONLY
   [[nodiscard]] std::optional<Error> format();
 #endif
@@ -160,6 +757,23 @@ public:
   [[nodiscard]] std::optional<Error>            close(FileHandle const fd);
 
   [[nodiscard]] std::variant<Error, size_t> read    (FileHandle const fd, void * read_buf, size_t const bytes_to_read);
+  /* Like read, but returns where up to 'bytes_to_read' bytes are
+   * found in memory-mapped flash (see FilesystemConfig::set_xip_base)
+   * instead of copying them. File data is contiguous within a block
+   * only, as blocks after the first start with skip-list pointers,
+   * so call it repeatedly until size is 0 for larger files. A file
+   * which fits into one block is returned at once. The data is valid
+   * until the file or filesystem is modified. On parts caching the
+   * XIP window, flush the cache after writes.
+   *
+   * Inlined files are returned from the file's cache, which is only
+   * valid until the file is read or closed, copy the data if needed
+   * longer. Only cache_size bytes of them are cached, for inlined data
+   * beyond that (a file written with a larger cache_size) NOTSUP is
+   * returned and read has to be used. The same goes for data beyond
+   * the size given to set_xip_base.
+   */
+  [[nodiscard]] std::variant<Error, MappedData> read_mapped(FileHandle const fd, size_t const bytes_to_read);
 #ifndef LFS_READONLY
   [[nodiscard]] std::variant<Error, size_t> write   (FileHandle const fd, void const * write_buf, size_t const bytes_to_write);
   [[nodiscard]] std::optional<Error>        truncate(FileHandle const fd, int const size);
@@ -178,10 +792,210 @@ public:
   [[nodiscard]] std::optional<Error>           dir_close(DirHandle const dd);
   [[nodiscard]] std::variant<Error, size_t>    dir_read(DirHandle const dd, std::string & name, Type & type);
   [[nodiscard]] std::optional<Error>           dir_rewind(DirHandle const dd);
+  [[nodiscard]] std::optional<Error>           dir_seek_name(DirHandle const dd, std::string const & name);
+  [[nodiscard]] std::variant<Error, DirRange>  dir_entries(DirHandle const dd);
+  [[nodiscard]] std::variant<Error, DirRange>  dir_entries(DirHandle const dd, std::string const & prefix);
 
   [[nodiscard]] std::variant<Error, size_t> fs_size();
+
+#ifndef LFS_READONLY
+  /* Compacts at most one metadata pair filled beyond the compact
+   * threshold, resuming where the previous call left off. Returns
+   * true if a pair was compacted, false once all pairs have been
+   * checked without finding one to compact. Calling this while
+   * idle keeps compactions out of later writes and syncs.
+   */
+  [[nodiscard]] std::variant<Error, bool> compact();
+
+  /* Performs up to 'budget' steps of background work which would
+   * otherwise stall a later write or sync: resolving orphans left
+   * by a power loss, repopulating an exhausted lookahead buffer
+   * and compacting metadata pairs beyond the compact threshold,
+   * one pair per step. Returns false only once no such work is
+   * left, true if work may remain.
+   */
+  [[nodiscard]] std::variant<Error, bool> maintain(size_t const budget);
+
+  /* Progress of resolving what a power loss left behind, which
+   * maintain does first. Reads never wait for it, the first write
+   * after mount completes whatever maintain has not done yet.
+   */
+  [[nodiscard]] std::variant<Error, Consistency> consistency();
+
+  /* Stores the state collected by mount in the root directory,
+   * so the next mount does not need to scan all metadata pairs
+   * as long as nothing has been committed since. Call it e.g.
+   * after syncing before an expected power-down.
+   */
+  [[nodiscard]] std::optional<Error> checkpoint();
+
+  /* Hands out free blocks in ascending order starting at 'block',
+   * e.g. to lay out the files written next contiguously when
+   * building an image. Mount starts at a pseudo-random block.
+   */
+  [[nodiscard]] std::optional<Error> alloc_seek(lfs_block_t const block);
+#endif
 };
 
+/* Read, write or sync request processed by an Executor. The
+ * request is owned by the submitting task and must stay alive
+ * until done() returns true. If a completion callback is given
+ * it is invoked from the worker before done() turns true. The
+ * callback must not release the request; the submitter may do so
+ * once done() returns true.
+ */
+class IoRequest
+{
+public:
+  enum class Op { READ, WRITE, SYNC };
+  typedef void (*CompletionFuncPtr)(IoRequest &);
+
+  static IoRequest read (FileHandle const fd, void * read_buf, size_t const bytes_to_read, CompletionFuncPtr on_complete = nullptr, void * user = nullptr)
+  {
+    return IoRequest(Op::READ, fd, read_buf, nullptr, bytes_to_read, on_complete, user);
+  }
+#ifndef LFS_READONLY
+  static IoRequest write(FileHandle const fd, void const * write_buf, size_t const bytes_to_write, CompletionFuncPtr on_complete = nullptr, void * user = nullptr)
+  {
+    return IoRequest(Op::WRITE, fd, nullptr, write_buf, bytes_to_write, on_complete, user);
+  }
+#endif
+  static IoRequest sync (FileHandle const fd, CompletionFuncPtr on_complete = nullptr, void * user = nullptr)
+  {
+    return IoRequest(Op::SYNC, fd, nullptr, nullptr, 0, on_complete, user);
+  }
+
+  IoRequest(IoRequest const &) = delete;
+  IoRequest & operator = (IoRequest const &) = delete;
+
+  [[nodiscard]] bool                        done  () const { return _done.load(std::memory_order_acquire); }
+  [[nodiscard]] std::variant<Error, size_t> result() const { return _result; }
+  [[nodiscard]] void *                      user  () const { return _user; }
+
+private:
+  friend class Executor;
+
+  Op _op;
+  FileHandle _fd;
+  void * _read_buf;
+  void const * _write_buf;
+  size_t _len;
+  CompletionFuncPtr _on_complete;
+  void * _user;
+  std::variant<Error, size_t> _result;
+  std::atomic<IoRequest *> _next;
+  IoRequest * _batch_next;
+  std::atomic<bool> _done;
+  bool _resume;
+
+  IoRequest(Op const op, FileHandle const fd, void * read_buf, void const * write_buf, size_t const len, CompletionFuncPtr on_complete, void * user)
+  : _op{op}
+  , _fd{fd}
+  , _read_buf{read_buf}
+  , _write_buf{write_buf}
+  , _len{len}
+  , _on_complete{on_complete}
+  , _user{user}
+  , _result{size_t{0}}
+  , _next{nullptr}
+  , _batch_next{nullptr}
+  , _done{false}
+  , _resume{false}
+  { }
+};
+
+/* Funnels the requests of any number of producer tasks through
+ * a lock-free multi-producer/single-consumer queue to a single
+ * worker, which is the only one calling into the Filesystem.
+ * The worker task repeatedly calls process(), all other tasks
+ * only call submit(). Sync requests are deferred to the end of
+ * each processed batch and served by a single sync per file.
+ */
+class Executor
+{
+private:
+  Filesystem & _fs;
+  IoRequest _stub;
+  std::atomic<IoRequest *> _head;
+  IoRequest * _tail;
+
+  void push(IoRequest * req);
+  IoRequest * pop();
+  void complete(IoRequest & req);
+
+public:
+  Executor(Filesystem & fs)
+  : _fs{fs}
+  , _stub{IoRequest::Op::SYNC, 0, nullptr, nullptr, 0, nullptr, nullptr}
+  , _head{&_stub}
+  , _tail{&_stub}
+  { }
+
+  Executor(Executor const &) = delete;
+  Executor & operator = (Executor const &) = delete;
+
+  void submit(IoRequest & req);
+  size_t process(size_t const max_requests = SIZE_MAX);
+
+#ifdef LITTLEFS_HAS_COROUTINES
+  class Awaitable;
+
+  [[nodiscard]] Awaitable async_read (FileHandle const fd, void * read_buf, size_t const bytes_to_read);
+#ifndef LFS_READONLY
+  [[nodiscard]] Awaitable async_write(FileHandle const fd, void const * write_buf, size_t const bytes_to_write);
+#endif
+  [[nodiscard]] Awaitable async_sync (FileHandle const fd);
+#endif
+};
+
+#ifdef LITTLEFS_HAS_COROUTINES
+/* Awaitable returned by the Executor::async_* functions (C++20).
+ * co_await submits the request and suspends the coroutine, which
+ * is resumed on the worker task once the request has completed
+ * and yields the result of the respective Filesystem call. The
+ * worker resumes it as its very last access to the request, as
+ * the coroutine may destroy the awaitable right away.
+ */
+class Executor::Awaitable
+{
+private:
+  Executor & _ex;
+  IoRequest _req;
+
+public:
+  Awaitable(Executor & ex, IoRequest::Op const op, FileHandle const fd, void * read_buf, void const * write_buf, size_t const len)
+  : _ex{ex}
+  , _req{op, fd, read_buf, write_buf, len, nullptr, nullptr}
+  { }
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle)
+  {
+    _req._user = handle.address();
+    _req._resume = true;
+    _ex.submit(_req);
+  }
+  std::variant<Error, size_t> await_resume() const { return _req.result(); }
+};
+
+inline Executor::Awaitable Executor::async_read(FileHandle const fd, void * read_buf, size_t const bytes_to_read)
+{
+  return Awaitable(*this, IoRequest::Op::READ, fd, read_buf, nullptr, bytes_to_read);
+}
+
+#ifndef LFS_READONLY
+inline Executor::Awaitable Executor::async_write(FileHandle const fd, void const * write_buf, size_t const bytes_to_write)
+{
+  return Awaitable(*this, IoRequest::Op::WRITE, fd, nullptr, write_buf, bytes_to_write);
+}
+#endif
+
+inline Executor::Awaitable Executor::async_sync(FileHandle const fd)
+{
+  return Awaitable(*this, IoRequest::Op::SYNC, fd, nullptr, nullptr, 0);
+}
+#endif
+
 /**************************************************************************************
  * FREE FUNCTIONS
  **************************************************************************************/
@@ -0,0 +1,189 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_BLANK_CHECK_BLOCK_DEVICE_H_
+#define _107_ARDUINO_LITTLEFS_BLANK_CHECK_BLOCK_DEVICE_H_
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+#include <array>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+struct BlankCheckStats
+{
+  uint32_t checks;          /* Blocks checked before erasing them. */
+  uint32_t erases_avoided;  /* Blocks found blank, their erase was skipped. */
+  uint64_t bytes_checked;   /* Bytes read for checking. */
+};
+
+/**************************************************************************************
+ * FUNCTION DEFINITION
+ **************************************************************************************/
+
+/* True if all 'size' bytes are 0xFF, i.e. read back as erased. */
+inline bool is_blank(uint8_t const * buf, size_t size)
+{
+#if defined(__SSE2__)
+  __m128i const ones = _mm_set1_epi8(static_cast<char>(0xFF));
+  for (; size >= 64; buf += 64, size -= 64)
+  {
+    __m128i const a = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<__m128i const *>(buf +  0)),
+                                    _mm_loadu_si128(reinterpret_cast<__m128i const *>(buf + 16)));
+    __m128i const b = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<__m128i const *>(buf + 32)),
+                                    _mm_loadu_si128(reinterpret_cast<__m128i const *>(buf + 48)));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(a, b), ones)) != 0xFFFF)
+      return false;
+  }
+#endif
+  for (; size >= sizeof(uint32_t); buf += sizeof(uint32_t), size -= sizeof(uint32_t))
+  {
+    uint32_t word;
+    memcpy(&word, buf, sizeof(word));
+    if (word != 0xFFFFFFFF)
+      return false;
+  }
+  for (; size > 0; buf++, size--)
+    if (*buf != 0xFF)
+      return false;
+  return true;
+}
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Skips erasing blocks which are still erased, e.g. after a chip
+ * erase or when littlefs allocates a block it never programmed.
+ * If the wrapped device provides
+ *
+ *   int is_erased(lfs_block_t block);
+ *
+ * returning 1 if erased, 0 if not or a negative lfs_error, e.g.
+ * by using the blank check command of the part, it is asked.
+ * Otherwise the block is read in CHUNK_SIZE pieces, stopping at
+ * the first byte other than 0xFF. CHUNK_SIZE must be a multiple
+ * of the read size and divide the block size.
+ *
+ * Only worthwhile if reading a block is much cheaper than erasing
+ * it, as on NOR flash. It relies on a block reading all 0xFF being
+ * as good as erased, which does not hold for parts with ECC, nor
+ * reliably for a block whose erase was cut short by power loss.
+ */
+template <typename BlockDevice, lfs_size_t CHUNK_SIZE>
+class BlankCheckBlockDevice
+{
+private:
+  template <typename T, typename = void>
+  struct has_is_erased : std::false_type { };
+  template <typename T>
+  struct has_is_erased<T, std::void_t<decltype(std::declval<T &>().is_erased(lfs_block_t{}))>> : std::true_type { };
+
+  BlockDevice & _dev;
+  lfs_size_t const _block_size;
+  BlankCheckStats _stats;
+  std::array<uint8_t, CHUNK_SIZE> _chunk;
+
+  /* 1 if erased, 0 if not or a negative lfs_error. */
+  int check(lfs_block_t const block)
+  {
+    _stats.checks++;
+    if constexpr (has_is_erased<BlockDevice>::value) {
+      return _dev.is_erased(block);
+    } else {
+      for (lfs_off_t off = 0; off < _block_size; off += CHUNK_SIZE)
+      {
+        if (int const rc = _dev.read(block, off, _chunk.data(), CHUNK_SIZE); rc < 0)
+          return rc;
+        _stats.bytes_checked += CHUNK_SIZE;
+        if (!is_blank(_chunk.data(), CHUNK_SIZE))
+          return 0;
+      }
+      return 1;
+    }
+  }
+
+public:
+  BlankCheckBlockDevice(BlockDevice & dev, lfs_size_t const block_size)
+  : _dev{dev}
+  , _block_size{block_size}
+  , _stats{}
+  , _chunk{}
+  { }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    return _dev.read(block, off, buffer, size);
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    return _dev.prog(block, off, buffer, size);
+  }
+  int erase(lfs_block_t const block)
+  {
+    int const rc = check(block);
+    if (rc < 0)
+      return rc;
+    if (rc > 0) {
+      _stats.erases_avoided++;
+      return LFS_ERR_OK;
+    }
+    return _dev.erase(block);
+  }
+  /* Only provided if the wrapped device provides it. The range is
+   * erased unless all of its blocks are blank.
+   */
+  template <typename T = BlockDevice>
+  auto erase_range(lfs_block_t const block, lfs_size_t const count) -> decltype(std::declval<T &>().erase_range(block, count))
+  {
+    for (lfs_size_t b = 0; b < count; b++)
+    {
+      int const rc = check(block + b);
+      if (rc < 0)
+        return rc;
+      if (rc == 0)
+        return _dev.erase_range(block, count);
+    }
+    _stats.erases_avoided += count;
+    return LFS_ERR_OK;
+  }
+  int sync()
+  {
+    return _dev.sync();
+  }
+
+  void reset() { _stats = BlankCheckStats{}; }
+  [[nodiscard]] BlankCheckStats const & stats() const { return _stats; }
+};
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_BLANK_CHECK_BLOCK_DEVICE_H_ */
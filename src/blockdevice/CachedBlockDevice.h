@@ -0,0 +1,171 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_CACHED_BLOCK_DEVICE_H_
+#define _107_ARDUINO_LITTLEFS_CACHED_BLOCK_DEVICE_H_
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Read cache of LINE_COUNT lines of LINE_SIZE bytes in front of
+ * the wrapped block device, evicting the least recently used
+ * line. LINE_SIZE must be a multiple of the read size and divide
+ * the block size. Programs are written through and update cached
+ * lines, erases invalidate all lines of the erased block.
+ */
+template <typename BlockDevice, lfs_size_t LINE_SIZE, size_t LINE_COUNT>
+class CachedBlockDevice
+{
+private:
+  static lfs_block_t constexpr INVALID_BLOCK = 0xFFFFFFFF;
+
+  struct Line
+  {
+    lfs_block_t block;
+    lfs_off_t off;
+    uint32_t age;
+  };
+
+  BlockDevice & _dev;
+  std::array<Line, LINE_COUNT> _line;
+  std::array<std::array<uint8_t, LINE_SIZE>, LINE_COUNT> _data;
+  uint32_t _tick;
+  uint32_t _hits;
+  uint32_t _misses;
+
+  size_t find(lfs_block_t const block, lfs_off_t const off) const
+  {
+    for (size_t l = 0; l < LINE_COUNT; l++)
+      if (_line[l].block == block && _line[l].off == off)
+        return l;
+    return LINE_COUNT;
+  }
+  size_t victim() const
+  {
+    size_t v = 0;
+    for (size_t l = 1; l < LINE_COUNT; l++)
+      if (_line[l].block == INVALID_BLOCK || (_line[v].block != INVALID_BLOCK && _line[l].age < _line[v].age))
+        v = l;
+    return v;
+  }
+
+public:
+  CachedBlockDevice(BlockDevice & dev)
+  : _dev{dev}
+  , _line{}
+  , _data{}
+  , _tick{0}
+  , _hits{0}
+  , _misses{0}
+  {
+    invalidate();
+  }
+
+  int read(lfs_block_t const block, lfs_off_t off, void * buffer, lfs_size_t size)
+  {
+    uint8_t * dst = static_cast<uint8_t *>(buffer);
+    while (size > 0)
+    {
+      lfs_off_t const line_off = off - (off % LINE_SIZE);
+      lfs_size_t const diff = LINE_SIZE - (off - line_off) < size ? LINE_SIZE - (off - line_off) : size;
+
+      size_t l = find(block, line_off);
+      if (l < LINE_COUNT) {
+        _hits++;
+      } else {
+        _misses++;
+        l = victim();
+        _line[l].block = INVALID_BLOCK;
+        if (int const rc = _dev.read(block, line_off, _data[l].data(), LINE_SIZE); rc < 0)
+          return rc;
+        _line[l].block = block;
+        _line[l].off = line_off;
+      }
+      _line[l].age = ++_tick;
+
+      memcpy(dst, _data[l].data() + (off - line_off), diff);
+      dst += diff;
+      off += diff;
+      size -= diff;
+    }
+    return LFS_ERR_OK;
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    int const rc = _dev.prog(block, off, buffer, size);
+
+    /* Keep cached lines coherent, or drop them if the program failed. */
+    for (size_t l = 0; l < LINE_COUNT; l++)
+    {
+      if (_line[l].block != block || _line[l].off + LINE_SIZE <= off || off + size <= _line[l].off)
+        continue;
+      if (rc < 0) {
+        _line[l].block = INVALID_BLOCK;
+        continue;
+      }
+      lfs_off_t const start = off > _line[l].off ? off : _line[l].off;
+      lfs_off_t const end = (off + size) < (_line[l].off + LINE_SIZE) ? (off + size) : (_line[l].off + LINE_SIZE);
+      memcpy(_data[l].data() + (start - _line[l].off), static_cast<uint8_t const *>(buffer) + (start - off), end - start);
+    }
+    return rc;
+  }
+  int erase(lfs_block_t const block)
+  {
+    for (auto & line : _line)
+      if (line.block == block)
+        line.block = INVALID_BLOCK;
+    return _dev.erase(block);
+  }
+  /* Only provided if the wrapped device provides it. */
+  template <typename T = BlockDevice>
+  auto erase_range(lfs_block_t const block, lfs_size_t const count) -> decltype(std::declval<T &>().erase_range(block, count))
+  {
+    for (auto & line : _line)
+      if (line.block != INVALID_BLOCK && line.block >= block && line.block - block < count)
+        line.block = INVALID_BLOCK;
+    return _dev.erase_range(block, count);
+  }
+  int sync()
+  {
+    return _dev.sync();
+  }
+
+  void invalidate()
+  {
+    for (auto & line : _line)
+      line = Line{INVALID_BLOCK, 0, 0};
+  }
+
+  [[nodiscard]] uint32_t hits() const { return _hits; }
+  [[nodiscard]] uint32_t misses() const { return _misses; }
+};
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_CACHED_BLOCK_DEVICE_H_ */
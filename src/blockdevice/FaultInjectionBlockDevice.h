@@ -0,0 +1,151 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_FAULT_INJECTION_BLOCK_DEVICE_H_
+#define _107_ARDUINO_LITTLEFS_FAULT_INJECTION_BLOCK_DEVICE_H_
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+#include <utility>
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Injects faults into the wrapped block device:
+ *
+ *  - power loss: after a given number of progs/erases the next
+ *    prog is torn (only its first half reaches the device) or
+ *    the next erase is dropped, and every following operation
+ *    fails with LFS_ERR_IO until power_cycle() is called. The
+ *    wrapped device then holds the state found after a reboot.
+ *  - bad blocks: progs and erases on blocks for which the
+ *    user-supplied predicate returns true fail with LFS_ERR_CORRUPT.
+ *  - read disturb: every n-th read has a single bit flipped.
+ */
+template <typename BlockDevice>
+class FaultInjectionBlockDevice
+{
+public:
+  typedef bool (*IsBadBlockFuncPtr)(lfs_block_t const block);
+
+private:
+  BlockDevice & _dev;
+  uint32_t _writes;
+  uint32_t _power_loss_after;
+  bool _powered;
+  IsBadBlockFuncPtr _is_bad_block;
+  uint32_t _reads;
+  uint32_t _bitflip_every;
+
+  bool power_lost()
+  {
+    if (!_power_loss_after)
+      return false;
+    if (++_writes < _power_loss_after)
+      return false;
+    _powered = false;
+    return true;
+  }
+
+public:
+  FaultInjectionBlockDevice(BlockDevice & dev)
+  : _dev{dev}
+  , _writes{0}
+  , _power_loss_after{0}
+  , _powered{true}
+  , _is_bad_block{nullptr}
+  , _reads{0}
+  , _bitflip_every{0}
+  { }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    if (!_powered)
+      return LFS_ERR_IO;
+    if (int const rc = _dev.read(block, off, buffer, size); rc < 0)
+      return rc;
+    if (_bitflip_every && size && (++_reads % _bitflip_every) == 0)
+      static_cast<uint8_t *>(buffer)[_reads % size] ^= (1 << (_reads % 8));
+    return LFS_ERR_OK;
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    if (!_powered)
+      return LFS_ERR_IO;
+    if (_is_bad_block && _is_bad_block(block))
+      return LFS_ERR_CORRUPT;
+    if (power_lost()) {
+      (void)_dev.prog(block, off, buffer, size / 2);
+      return LFS_ERR_IO;
+    }
+    return _dev.prog(block, off, buffer, size);
+  }
+  int erase(lfs_block_t const block)
+  {
+    if (!_powered)
+      return LFS_ERR_IO;
+    if (_is_bad_block && _is_bad_block(block))
+      return LFS_ERR_CORRUPT;
+    if (power_lost())
+      return LFS_ERR_IO;
+    return _dev.erase(block);
+  }
+  /* Only provided if the wrapped device provides it. A ranged
+   * erase cut by power loss only erases the first half of the range.
+   */
+  template <typename T = BlockDevice>
+  auto erase_range(lfs_block_t const block, lfs_size_t const count) -> decltype(std::declval<T &>().erase_range(block, count))
+  {
+    if (!_powered)
+      return LFS_ERR_IO;
+    for (lfs_size_t b = block; _is_bad_block && b < block + count; b++)
+      if (_is_bad_block(b))
+        return LFS_ERR_CORRUPT;
+    if (power_lost()) {
+      if (count / 2)
+        (void)_dev.erase_range(block, count / 2);
+      return LFS_ERR_IO;
+    }
+    return _dev.erase_range(block, count);
+  }
+  int sync()
+  {
+    if (!_powered)
+      return LFS_ERR_IO;
+    return _dev.sync();
+  }
+
+  /* 0 disables power loss injection. */
+  void set_power_loss_after(uint32_t const writes) { _power_loss_after = writes; _writes = 0; }
+  void set_bad_block(IsBadBlockFuncPtr is_bad_block) { _is_bad_block = is_bad_block; }
+  /* 0 disables bit flips. */
+  void set_read_bitflip_every(uint32_t const reads) { _bitflip_every = reads; _reads = 0; }
+
+  void power_cycle() { _powered = true; _writes = 0; _power_loss_after = 0; }
+  [[nodiscard]] bool powered() const { return _powered; }
+  [[nodiscard]] uint32_t writes() const { return _writes; }
+};
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_FAULT_INJECTION_BLOCK_DEVICE_H_ */
@@ -0,0 +1,81 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_FLASH_TIMING_H_
+#define _107_ARDUINO_LITTLEFS_FLASH_TIMING_H_
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+/* Timing model of a memory part, shared by LatencyBlockDevice
+ * and SimulatedFlashBlockDevice. Reads and programs cost the
+ * command overhead, the bus transfer and the array time of every
+ * page touched, erases the command overhead plus the block erase
+ * time.
+ */
+struct FlashTiming
+{
+  uint32_t page_size;        /* Program page / read page size in bytes. */
+  uint32_t cmd_us;           /* Command and address overhead per operation. */
+  uint32_t page_read_us;     /* Array to page buffer, per page read (tR). */
+  uint32_t page_prog_us;     /* Page buffer to array, per page programmed (tPP). */
+  uint32_t block_erase_us;   /* Per block erased (tBE). */
+  uint32_t bus_bytes_per_s;  /* Data transfer rate between host and device. */
+  bool erase_suspend;        /* Reads may suspend an erase in progress. */
+  uint32_t suspend_us;       /* Suspend latency (tSUS). */
+  uint32_t resume_us;        /* Resume overhead added to the erase. */
+  uint32_t bulk_erase_size;  /* Size erased by the larger erase command, 0 if none. */
+  uint32_t bulk_erase_us;    /* Per bulk erase (e.g. tBE2 for 64 KiB). */
+
+  [[nodiscard]] uint64_t transfer_us(lfs_size_t const size) const
+  {
+    return (static_cast<uint64_t>(size) * 1000000 + bus_bytes_per_s - 1) / bus_bytes_per_s;
+  }
+  [[nodiscard]] uint32_t pages(lfs_off_t const off, lfs_size_t const size) const
+  {
+    return size ? ((off + size - 1) / page_size - off / page_size + 1) : 0;
+  }
+  [[nodiscard]] uint64_t read_us(lfs_off_t const off, lfs_size_t const size) const
+  {
+    return cmd_us + static_cast<uint64_t>(pages(off, size)) * page_read_us + transfer_us(size);
+  }
+  [[nodiscard]] uint64_t prog_us(lfs_off_t const off, lfs_size_t const size) const
+  {
+    return cmd_us + transfer_us(size) + static_cast<uint64_t>(pages(off, size)) * page_prog_us;
+  }
+  [[nodiscard]] uint64_t erase_us() const
+  {
+    return cmd_us + block_erase_us;
+  }
+};
+
+/* Typical datasheet figures. */
+inline constexpr FlashTiming SPI_NOR_FLASH  = {  256,  1,  0,  700, 45000, 25000000, true,  20, 10, 65536, 150000 }; /* W25Q-style quad SPI NOR @ 50 MHz, 4 KiB sectors, 64 KiB blocks. */
+inline constexpr FlashTiming SPI_NAND_FLASH = { 2048,  1, 25,  250,  2000, 13000000, false,  0,  0,     0,      0 }; /* SPI NAND @ 104 MHz single, 128 KiB blocks. */
+inline constexpr FlashTiming I2C_EEPROM     = {   64, 50,  0, 5000, 20000,    44000, false,  0,  0,     0,      0 }; /* 400 kHz I2C 24LCxx, erase emulated by filling 4 pages. */
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_FLASH_TIMING_H_ */
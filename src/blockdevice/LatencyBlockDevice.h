@@ -0,0 +1,96 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_LATENCY_BLOCK_DEVICE_H_
+#define _107_ARDUINO_LITTLEFS_LATENCY_BLOCK_DEVICE_H_
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+#include "FlashTiming.h"
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Delays every operation of the wrapped block device according
+ * to a FlashTiming, e.g. for running a RAM-backed device
+ * at the speed of a real part. The delay function is supplied
+ * by the caller (delayMicroseconds on Arduino, sleep_for on a
+ * host). The modelled time is accumulated in elapsed_us() even
+ * without a delay function. Unlike SimulatedFlashBlockDevice,
+ * erases block for their full duration.
+ */
+template <typename BlockDevice>
+class LatencyBlockDevice
+{
+public:
+  typedef void (*DelayFuncPtr)(uint32_t const us);
+
+private:
+  BlockDevice & _dev;
+  FlashTiming _timing;
+  DelayFuncPtr _delay;
+  uint64_t _elapsed_us;
+
+  void wait(uint64_t const us)
+  {
+    _elapsed_us += us;
+    if (_delay && us)
+      _delay(static_cast<uint32_t>(us));
+  }
+
+public:
+  LatencyBlockDevice(BlockDevice & dev, FlashTiming const & timing, DelayFuncPtr delay)
+  : _dev{dev}
+  , _timing{timing}
+  , _delay{delay}
+  , _elapsed_us{0}
+  { }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    wait(_timing.read_us(off, size));
+    return _dev.read(block, off, buffer, size);
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    wait(_timing.prog_us(off, size));
+    return _dev.prog(block, off, buffer, size);
+  }
+  int erase(lfs_block_t const block)
+  {
+    wait(_timing.erase_us());
+    return _dev.erase(block);
+  }
+  int sync()
+  {
+    return _dev.sync();
+  }
+
+  void set_timing(FlashTiming const & timing) { _timing = timing; }
+  void reset_elapsed() { _elapsed_us = 0; }
+  [[nodiscard]] uint64_t elapsed_us() const { return _elapsed_us; }
+};
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_LATENCY_BLOCK_DEVICE_H_ */
@@ -0,0 +1,183 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_MMAP_BLOCK_DEVICE_H_
+#define _107_ARDUINO_LITTLEFS_MMAP_BLOCK_DEVICE_H_
+
+/* Host only, as it needs POSIX mmap. Therefore it is not included
+ * by 107-Arduino-littlefs.h, include it explicitly:
+ *
+ *   #include <blockdevice/MmapBlockDevice.h>
+ */
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstring>
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+enum class MmapMode : int
+{
+  READ_ONLY,   /* Existing image, progs and erases fail. */
+  READ_WRITE,  /* Existing image. */
+  CREATE,      /* New or truncated image of block_count erased blocks. */
+};
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Block device on an image file mapped into memory. Reads are
+ * copies out of the mapping, progs and erases copy into it, so
+ * no system call is made per operation and the kernel writes the
+ * dirty pages back to the file. If sync_to_file is set, sync()
+ * waits for this with msync(), otherwise the image is complete
+ * once close() returns.
+ *
+ * open() returns LFS_ERR_OK or a negative lfs_error. The block
+ * count of an existing image is taken from its size unless given.
+ */
+class MmapBlockDevice
+{
+private:
+  lfs_size_t const _block_size;
+  bool const _sync_to_file;
+  int _fd;
+  uint8_t * _buf;
+  lfs_size_t _block_count;
+  bool _writable;
+
+public:
+  MmapBlockDevice(lfs_size_t const block_size, bool const sync_to_file = false)
+  : _block_size{block_size}
+  , _sync_to_file{sync_to_file}
+  , _fd{-1}
+  , _buf{nullptr}
+  , _block_count{0}
+  , _writable{false}
+  { }
+  ~MmapBlockDevice()
+  {
+    close();
+  }
+  MmapBlockDevice(MmapBlockDevice const &) = delete;
+  MmapBlockDevice & operator = (MmapBlockDevice const &) = delete;
+
+  [[nodiscard]] int open(char const * path, MmapMode const mode, lfs_size_t block_count = 0)
+  {
+    close();
+
+    int const flags = (mode == MmapMode::READ_ONLY) ? O_RDONLY : (mode == MmapMode::CREATE) ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR;
+    int const fd = ::open(path, flags, 0644);
+    if (fd < 0)
+      return LFS_ERR_IO;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      return LFS_ERR_IO;
+    }
+    if (block_count == 0 && mode != MmapMode::CREATE)
+      block_count = static_cast<lfs_size_t>(st.st_size / _block_size);
+    size_t const size = static_cast<size_t>(block_count) * _block_size;
+    if (size == 0 || (mode == MmapMode::CREATE ? ftruncate(fd, static_cast<off_t>(size)) != 0 : static_cast<size_t>(st.st_size) < size)) {
+      ::close(fd);
+      return LFS_ERR_INVAL;
+    }
+
+    void * const buf = mmap(nullptr, size, (mode == MmapMode::READ_ONLY) ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+    if (buf == MAP_FAILED) {
+      ::close(fd);
+      return LFS_ERR_IO;
+    }
+
+    _fd = fd;
+    _buf = static_cast<uint8_t *>(buf);
+    _block_count = block_count;
+    _writable = (mode != MmapMode::READ_ONLY);
+    if (mode == MmapMode::CREATE)
+      memset(_buf, 0xFF, size);
+    return LFS_ERR_OK;
+  }
+  void close()
+  {
+    if (_buf)
+      munmap(_buf, static_cast<size_t>(_block_count) * _block_size);
+    if (_fd >= 0)
+      ::close(_fd);
+    _fd = -1;
+    _buf = nullptr;
+    _block_count = 0;
+    _writable = false;
+  }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    if (block >= _block_count || off + size > _block_size)
+      return LFS_ERR_INVAL;
+    memcpy(buffer, _buf + static_cast<size_t>(block) * _block_size + off, size);
+    return LFS_ERR_OK;
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    if (block >= _block_count || off + size > _block_size)
+      return LFS_ERR_INVAL;
+    if (!_writable)
+      return LFS_ERR_IO;
+    memcpy(_buf + static_cast<size_t>(block) * _block_size + off, buffer, size);
+    return LFS_ERR_OK;
+  }
+  int erase(lfs_block_t const block)
+  {
+    return erase_range(block, 1);
+  }
+  int erase_range(lfs_block_t const block, lfs_size_t const count)
+  {
+    if (block >= _block_count || count > _block_count - block)
+      return LFS_ERR_INVAL;
+    if (!_writable)
+      return LFS_ERR_IO;
+    memset(_buf + static_cast<size_t>(block) * _block_size, 0xFF, static_cast<size_t>(count) * _block_size);
+    return LFS_ERR_OK;
+  }
+  int sync()
+  {
+    if (!_sync_to_file || !_writable)
+      return LFS_ERR_OK;
+    return msync(_buf, static_cast<size_t>(_block_count) * _block_size, MS_SYNC) == 0 ? LFS_ERR_OK : LFS_ERR_IO;
+  }
+
+  [[nodiscard]] uint8_t const * data() const { return _buf; }
+  [[nodiscard]] lfs_size_t block_size() const { return _block_size; }
+  [[nodiscard]] lfs_size_t block_count() const { return _block_count; }
+};
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_MMAP_BLOCK_DEVICE_H_ */
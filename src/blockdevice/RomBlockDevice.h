@@ -0,0 +1,96 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_ROM_BLOCK_DEVICE_H_
+#define _107_ARDUINO_LITTLEFS_ROM_BLOCK_DEVICE_H_
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+#include <cstring>
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Read-only block device over an image linked into the firmware,
+ * e.g. the array of a header generated by extras/mkimage -H. The
+ * image may be shorter than block_size * block_count, the missing
+ * tail reads as erased. Progs and erases fail, so build with
+ * LFS_READONLY to drop the write paths of littlefs altogether:
+ *
+ *   RomBlockDevice rom(assets, sizeof(assets), assets_block_size, assets_block_count);
+ *   BlockDeviceConfig<RomBlockDevice> cfg(rom, assets_read_size, assets_prog_size, assets_block_size, assets_block_count, -1, assets_cache_size, 8);
+ *   cfg.set_xip_base(assets, sizeof(assets));
+ *
+ * As the image is in the address space, set_xip_base lets
+ * Filesystem::read_mapped hand out the file data without copies.
+ * Use the cache size the image was built with, as read_mapped maps
+ * files inlined into their metadata pair only up to the cache size.
+ */
+class RomBlockDevice
+{
+private:
+  uint8_t const * _image;
+  size_t const _image_size;
+  lfs_size_t const _block_size;
+  lfs_size_t const _block_count;
+
+public:
+  RomBlockDevice(uint8_t const * image, size_t const image_size, lfs_size_t const block_size, lfs_size_t const block_count)
+  : _image{image}
+  , _image_size{image_size}
+  , _block_size{block_size}
+  , _block_count{block_count}
+  { }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    if (block >= _block_count || off + size > _block_size)
+      return LFS_ERR_INVAL;
+
+    size_t const pos = static_cast<size_t>(block) * _block_size + off;
+    size_t const avail = (pos < _image_size) ? ((_image_size - pos < size) ? (_image_size - pos) : size) : 0;
+    if (avail)
+      memcpy(buffer, _image + pos, avail);
+    memset(static_cast<uint8_t *>(buffer) + avail, 0xFF, size - avail);
+    return LFS_ERR_OK;
+  }
+  int prog(lfs_block_t const, lfs_off_t const, const void *, lfs_size_t const)
+  {
+    return LFS_ERR_IO;
+  }
+  int erase(lfs_block_t const)
+  {
+    return LFS_ERR_IO;
+  }
+  int sync()
+  {
+    return LFS_ERR_OK;
+  }
+
+  [[nodiscard]] lfs_size_t block_size () const { return _block_size; }
+  [[nodiscard]] lfs_size_t block_count() const { return _block_count; }
+};
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_ROM_BLOCK_DEVICE_H_ */
@@ -0,0 +1,167 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_SIMULATED_FLASH_BLOCK_DEVICE_H_
+#define _107_ARDUINO_LITTLEFS_SIMULATED_FLASH_BLOCK_DEVICE_H_
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+#include "FlashTiming.h"
+
+#include <cstring>
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* RAM-backed flash simulator keeping a simulated clock instead
+ * of delaying. Reads and programs cost the command overhead,
+ * the bus transfer and the array time of every page touched.
+ * Programs can only clear bits, as on real flash. Erases run in
+ * the background of the simulated device: the next operation
+ * waits for the erase to finish, unless it is a read and the
+ * part supports erase-suspend, in which case only the suspend
+ * latency is paid and the erase is pushed back accordingly.
+ * erase_range() uses the bulk erase for every aligned bulk
+ * erase unit covered by the range.
+ *
+ * advance() accounts for time spent by the host between device
+ * operations and measure() returns the simulated time spent
+ * by a callable, e.g. a single Filesystem operation.
+ */
+class SimulatedFlashBlockDevice
+{
+private:
+  uint8_t * _buf;
+  lfs_size_t const _block_size;
+  lfs_size_t const _block_count;
+  FlashTiming _timing;
+  uint64_t _now_us;
+  uint64_t _erase_done_us;
+
+  void wait_for_erase()
+  {
+    if (_now_us < _erase_done_us)
+      _now_us = _erase_done_us;
+  }
+
+public:
+  SimulatedFlashBlockDevice(uint8_t * buf, lfs_size_t const block_size, lfs_size_t const block_count, FlashTiming const & timing)
+  : _buf{buf}
+  , _block_size{block_size}
+  , _block_count{block_count}
+  , _timing{timing}
+  , _now_us{0}
+  , _erase_done_us{0}
+  { }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    if (block >= _block_count || off + size > _block_size)
+      return LFS_ERR_INVAL;
+
+    uint64_t const duration_us = _timing.read_us(off, size);
+    if (_now_us < _erase_done_us && _timing.erase_suspend) {
+      _now_us += _timing.suspend_us + duration_us;
+      _erase_done_us += _timing.suspend_us + duration_us + _timing.resume_us;
+    } else {
+      wait_for_erase();
+      _now_us += duration_us;
+    }
+
+    memcpy(buffer, _buf + block * _block_size + off, size);
+    return LFS_ERR_OK;
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    if (block >= _block_count || off + size > _block_size)
+      return LFS_ERR_INVAL;
+
+    wait_for_erase();
+    _now_us += _timing.prog_us(off, size);
+
+    uint8_t * dst = _buf + block * _block_size + off;
+    uint8_t const * src = static_cast<uint8_t const *>(buffer);
+    for (lfs_size_t i = 0; i < size; i++)
+      dst[i] &= src[i];
+    return LFS_ERR_OK;
+  }
+  int erase(lfs_block_t const block)
+  {
+    if (block >= _block_count)
+      return LFS_ERR_INVAL;
+
+    wait_for_erase();
+    _now_us += _timing.cmd_us;
+    _erase_done_us = _now_us + _timing.block_erase_us;
+
+    memset(_buf + block * _block_size, 0xFF, _block_size);
+    return LFS_ERR_OK;
+  }
+  int erase_range(lfs_block_t const block, lfs_size_t const count)
+  {
+    if (block >= _block_count || count > _block_count - block)
+      return LFS_ERR_INVAL;
+
+    lfs_size_t const bulk_blocks = _timing.bulk_erase_size / _block_size;
+    for (lfs_block_t b = block; b < block + count; )
+    {
+      if (bulk_blocks > 1 && b % bulk_blocks == 0 && block + count - b >= bulk_blocks)
+      {
+        wait_for_erase();
+        _now_us += _timing.cmd_us;
+        _erase_done_us = _now_us + _timing.bulk_erase_us;
+        memset(_buf + b * _block_size, 0xFF, bulk_blocks * _block_size);
+        b += bulk_blocks;
+      }
+      else
+      {
+        (void)erase(b);
+        b++;
+      }
+    }
+    return LFS_ERR_OK;
+  }
+  int sync()
+  {
+    wait_for_erase();
+    return LFS_ERR_OK;
+  }
+
+  void advance(uint64_t const us) { _now_us += us; }
+  [[nodiscard]] uint64_t now_us() const { return _now_us; }
+
+  template <typename Func>
+  [[nodiscard]] uint64_t measure(Func && func)
+  {
+    uint64_t const start_us = _now_us;
+    func();
+    return _now_us - start_us;
+  }
+
+  [[nodiscard]] lfs_size_t block_size() const { return _block_size; }
+  [[nodiscard]] lfs_size_t block_count() const { return _block_count; }
+};
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_SIMULATED_FLASH_BLOCK_DEVICE_H_ */
@@ -0,0 +1,120 @@
+/**
+ * This software is distributed under the terms of the MIT License.
+ * Copyright (c) 2023 LXRobotics.
+ * Author: Alexander Entinger <alexander.entinger@lxrobotics.com>
+ * Contributors: https://github.com/107-systems/107-Arduino-littlefs/graphs/contributors.
+ */
+
+#ifndef _107_ARDUINO_LITTLEFS_STATS_BLOCK_DEVICE_H_
+#define _107_ARDUINO_LITTLEFS_STATS_BLOCK_DEVICE_H_
+
+/**************************************************************************************
+ * INCLUDE
+ **************************************************************************************/
+
+#include "../littlefs-v2.5.1/lfs.h"
+
+#include <utility>
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+namespace littlefs
+{
+
+/**************************************************************************************
+ * TYPEDEF
+ **************************************************************************************/
+
+struct BlockDeviceStats
+{
+  uint32_t reads;
+  uint32_t progs;
+  uint32_t erases;
+  uint32_t syncs;
+  uint64_t bytes_read;
+  uint64_t bytes_programmed;
+};
+
+/**************************************************************************************
+ * CLASS DECLARATION
+ **************************************************************************************/
+
+/* Records the number of operations and bytes transferred by
+ * the wrapped block device. If an erase count buffer with one
+ * entry per block is provided, per-block erase counts are kept
+ * as well, e.g. for evaluating wear distribution. A ranged
+ * erase counts as one erase per block of the range.
+ */
+template <typename BlockDevice>
+class StatsBlockDevice
+{
+private:
+  BlockDevice & _dev;
+  BlockDeviceStats _stats;
+  uint32_t * _erase_count;
+  lfs_size_t const _block_count;
+
+public:
+  StatsBlockDevice(BlockDevice & dev, uint32_t * erase_count = nullptr, lfs_size_t const block_count = 0)
+  : _dev{dev}
+  , _stats{}
+  , _erase_count{erase_count}
+  , _block_count{block_count}
+  {
+    reset();
+  }
+
+  int read(lfs_block_t const block, lfs_off_t const off, void * buffer, lfs_size_t const size)
+  {
+    _stats.reads++;
+    _stats.bytes_read += size;
+    return _dev.read(block, off, buffer, size);
+  }
+  int prog(lfs_block_t const block, lfs_off_t const off, const void * buffer, lfs_size_t const size)
+  {
+    _stats.progs++;
+    _stats.bytes_programmed += size;
+    return _dev.prog(block, off, buffer, size);
+  }
+  int erase(lfs_block_t const block)
+  {
+    _stats.erases++;
+    if (_erase_count && block < _block_count)
+      _erase_count[block]++;
+    return _dev.erase(block);
+  }
+  /* Only provided if the wrapped device provides it. */
+  template <typename T = BlockDevice>
+  auto erase_range(lfs_block_t const block, lfs_size_t const count) -> decltype(std::declval<T &>().erase_range(block, count))
+  {
+    _stats.erases += count;
+    for (lfs_size_t b = block; _erase_count && b < block + count && b < _block_count; b++)
+      _erase_count[b]++;
+    return _dev.erase_range(block, count);
+  }
+  int sync()
+  {
+    _stats.syncs++;
+    return _dev.sync();
+  }
+
+  void reset()
+  {
+    _stats = BlockDeviceStats{};
+    for (lfs_size_t b = 0; _erase_count && b < _block_count; b++)
+      _erase_count[b] = 0;
+  }
+
+  [[nodiscard]] BlockDeviceStats const & stats() const { return _stats; }
+  [[nodiscard]] uint32_t erase_count(lfs_block_t const block) const { return (_erase_count && block < _block_count) ? _erase_count[block] : 0; }
+};
+
+/**************************************************************************************
+ * NAMESPACE
+ **************************************************************************************/
+
+} /* littlefs */
+
+#endif /* _107_ARDUINO_LITTLEFS_STATS_BLOCK_DEVICE_H_ */
@@ -11,7 +11,6 @@
 
 // some constants used throughout the code
 #define LFS_BLOCK_NULL ((lfs_block_t)-1)
-#define LFS_BLOCK_INLINE ((lfs_block_t)-2)
 
 enum {
     LFS_OK_RELOCATED = 1,
@@ -253,10 +252,35 @@ static int lfs_bd_prog(lfs_t *lfs,
 #ifndef LFS_READONLY
 static int lfs_bd_erase(lfs_t *lfs, lfs_block_t block) {
     LFS_ASSERT(block < lfs->cfg->block_count);
+    // already erased by lfs_bd_eraserange and untouched since?
+    lfs_block_t i = block - lfs->erased.block;
+    if (i < 32 && (lfs->erased.mask & (1U << i))) {
+        lfs->erased.mask &= ~(1U << i);
+        return 0;
+    }
+
     int err = lfs->cfg->erase(lfs->cfg, block);
     LFS_ASSERT(err <= 0);
     return err;
 }
+
+// erases up to 32 blocks, the following lfs_bd_erase calls on them are
+// skipped once
+static void lfs_bd_eraserange(lfs_t *lfs, lfs_block_t block,
+        lfs_size_t count) {
+    LFS_ASSERT(block + count <= lfs->cfg->block_count);
+    LFS_ASSERT(count <= 32);
+    int err = lfs->cfg->erase_range(lfs->cfg, block, count);
+    LFS_ASSERT(err <= 0);
+    if (err) {
+        // let the single block erases report the error
+        lfs->erased.mask = 0;
+        return;
+    }
+
+    lfs->erased.block = block;
+    lfs->erased.mask = (count < 32) ? (1U << count) - 1 : 0xffffffff;
+}
 #endif
 
 
@@ -279,14 +303,12 @@ static inline int lfs_pair_cmp(
              paira[0] == pairb[1] || paira[1] == pairb[0]);
 }
 
-#ifndef LFS_READONLY
 static inline bool lfs_pair_sync(
         const lfs_block_t paira[2],
         const lfs_block_t pairb[2]) {
     return (paira[0] == pairb[0] && paira[1] == pairb[1]) ||
            (paira[0] == pairb[1] && paira[1] == pairb[0]);
 }
-#endif
 
 static inline void lfs_pair_fromle32(lfs_block_t pair[2]) {
     pair[0] = lfs_fromle32(pair[0]);
@@ -515,6 +537,24 @@ static int lfs_file_rawclose(lfs_t *lfs, lfs_file_t *file);
 static lfs_soff_t lfs_file_rawsize(lfs_t *lfs, lfs_file_t *file);
 
 static lfs_ssize_t lfs_fs_rawsize(lfs_t *lfs);
+#ifndef LFS_READONLY
+static int lfs_fs_rawcompact(lfs_t *lfs);
+static int lfs_fs_rawmkconsistent(lfs_t *lfs);
+static int lfs_fs_rawconsistency(lfs_t *lfs,
+        struct lfs_fsconsistency *consistency);
+static int lfs_fs_rawprealloc(lfs_t *lfs);
+static int lfs_fs_rawcheckpoint(lfs_t *lfs);
+static int lfs_fs_rawallocseek(lfs_t *lfs, lfs_block_t block);
+static int lfs_fs_uncheckpoint(lfs_t *lfs);
+#endif
+static int lfs_fs_getcheckpoint(lfs_t *lfs, const lfs_mdir_t *dir,
+        lfs_gstate_t *gstate);
+#ifndef LFS_READONLY
+static void lfs_fs_unretain(lfs_t *lfs);
+#endif
+static void lfs_fs_retain(lfs_t *lfs);
+static bool lfs_fs_resume(lfs_t *lfs);
+static void lfs_fs_deorphanrestart(struct lfs_deorphan *walk);
 static int lfs_fs_rawtraverse(lfs_t *lfs,
         int (*cb)(void *data, lfs_block_t block), void *data,
         bool includeorphans);
@@ -554,7 +594,29 @@ static void lfs_alloc_drop(lfs_t *lfs) {
 }
 
 #ifndef LFS_READONLY
-static int lfs_alloc(lfs_t *lfs, lfs_block_t *block) {
+static int lfs_alloc_scan(lfs_t *lfs) {
+    // move the lookahead window past the blocks already handed out
+    lfs->free.off = (lfs->free.off + lfs->free.size)
+            % lfs->cfg->block_count;
+    lfs->free.size = lfs_min(8*lfs->cfg->lookahead_size, lfs->free.ack);
+    lfs->free.i = 0;
+
+    // find mask of free blocks from tree
+    memset(lfs->free.buffer, 0, lfs->cfg->lookahead_size);
+    int err = lfs_fs_rawtraverse(lfs, lfs_alloc_lookahead, lfs, true);
+    if (err) {
+        lfs_alloc_drop(lfs);
+        return err;
+    }
+
+    return 0;
+}
+#endif
+
+#ifndef LFS_READONLY
+// count is the number of blocks the caller is about to write, which bounds
+// the run of free blocks erased in advance
+static int lfs_alloc(lfs_t *lfs, lfs_block_t *block, lfs_size_t count) {
     while (true) {
         while (lfs->free.i != lfs->free.size) {
             lfs_block_t off = lfs->free.i;
@@ -565,6 +627,25 @@ static int lfs_alloc(lfs_t *lfs, lfs_block_t *block) {
                 // found a free block
                 *block = (lfs->free.off + off) % lfs->cfg->block_count;
 
+                // erase the run of free blocks the caller needs starting
+                // here in one go, unless an earlier run already covers it
+                lfs_block_t erased = *block - lfs->erased.block;
+                if (lfs->cfg->erase_range && count > 1 && (erased >= 32 ||
+                        !(lfs->erased.mask & (1U << erased)))) {
+                    lfs_size_t run = 1;
+                    while (run < lfs_min(count, 32) &&
+                            off + run < lfs->free.size &&
+                            *block + run < lfs->cfg->block_count &&
+                            !(lfs->free.buffer[(off + run) / 32]
+                                & (1U << ((off + run) % 32)))) {
+                        run += 1;
+                    }
+
+                    if (run > 1) {
+                        lfs_bd_eraserange(lfs, *block, run);
+                    }
+                }
+
                 // eagerly find next off so an alloc ack can
                 // discredit old lookahead blocks
                 while (lfs->free.i != lfs->free.size &&
@@ -585,16 +666,8 @@ static int lfs_alloc(lfs_t *lfs, lfs_block_t *block) {
             return LFS_ERR_NOSPC;
         }
 
-        lfs->free.off = (lfs->free.off + lfs->free.size)
-                % lfs->cfg->block_count;
-        lfs->free.size = lfs_min(8*lfs->cfg->lookahead_size, lfs->free.ack);
-        lfs->free.i = 0;
-
-        // find mask of free blocks from tree
-        memset(lfs->free.buffer, 0, lfs->cfg->lookahead_size);
-        int err = lfs_fs_rawtraverse(lfs, lfs_alloc_lookahead, lfs, true);
+        int err = lfs_alloc_scan(lfs);
         if (err) {
-            lfs_alloc_drop(lfs);
             return err;
         }
     }
@@ -1316,6 +1389,94 @@ static int lfs_dir_find_match(void *data,
     return LFS_CMP_EQ;
 }
 
+static lfs_dircache_t *lfs_dircache_slot(lfs_t *lfs,
+        const lfs_block_t pair[2]) {
+    // pairs never share blocks, so either block identifies the pair
+    return &lfs->dircache[lfs_min(pair[0], pair[1]) % lfs->cfg->dircache_size];
+}
+
+static void lfs_dircache_reset(lfs_t *lfs) {
+    for (lfs_size_t i = 0; i < lfs->cfg->dircache_size; i++) {
+        lfs->dircache[i].namelen = 0;
+    }
+}
+
+#ifndef LFS_READONLY
+static void lfs_dircache_drop(lfs_t *lfs, const lfs_block_t pair[2]) {
+    if (lfs->cfg->dircache_size) {
+        lfs_dircache_t *slot = lfs_dircache_slot(lfs, pair);
+        if (lfs_pair_sync(slot->pair, pair)) {
+            slot->namelen = 0;
+        }
+    }
+}
+#endif
+
+static int lfs_dircache_update(lfs_t *lfs, lfs_mdir_t *dir) {
+    if (!lfs->cfg->dircache_size || dir->count == 0) {
+        return 0;
+    }
+
+    lfs_dircache_t *slot = lfs_dircache_slot(lfs, dir->pair);
+    if (slot->namelen && lfs_pair_sync(slot->pair, dir->pair)) {
+        return 0;
+    }
+
+    // only the last name is needed, entries are sorted
+    uint8_t name[LFS_DIRCACHE_NAME];
+    lfs_stag_t tag = lfs_dir_get(lfs, dir, LFS_MKTAG(0x780, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_NAME, dir->count-1, sizeof(name)), name);
+    if (tag < 0) {
+        // last id may be pending a move, simply don't cache this pair
+        return (tag == LFS_ERR_NOENT) ? 0 : (int)tag;
+    }
+
+    slot->pair[0] = dir->pair[0];
+    slot->pair[1] = dir->pair[1];
+    slot->tail[0] = dir->tail[0];
+    slot->tail[1] = dir->tail[1];
+    slot->count = dir->count;
+    slot->split = dir->split;
+    memcpy(slot->name, name, sizeof(name));
+    slot->namelen = lfs_tag_size(tag);
+    return 0;
+}
+
+// step over metadata pairs whose entries all sort in front of name, this
+// must agree with lfs_dir_find_match (or lfs_dir_prefix_match for prefixes)
+static void lfs_dircache_skip(lfs_t *lfs, lfs_block_t pair[2],
+        const char *name, lfs_size_t namelen, bool prefix, lfs_off_t *ids) {
+    if (!lfs->cfg->dircache_size) {
+        return;
+    }
+
+    while (true) {
+        lfs_dircache_t *slot = lfs_dircache_slot(lfs, pair);
+        if (!slot->namelen || !slot->split ||
+                !lfs_pair_sync(slot->pair, pair)) {
+            return;
+        }
+
+        lfs_size_t size = lfs_min(slot->namelen, LFS_DIRCACHE_NAME);
+        int res = memcmp(slot->name, name, lfs_min(namelen, size));
+        bool before = (res < 0);
+        if (!prefix && res == 0) {
+            // longer names sort in front of their prefixes
+            before = (namelen <= size && namelen < slot->namelen);
+        }
+
+        if (!before) {
+            return;
+        }
+
+        if (ids) {
+            *ids += slot->count;
+        }
+        pair[0] = slot->tail[0];
+        pair[1] = slot->tail[1];
+    }
+}
+
 static lfs_stag_t lfs_dir_find(lfs_t *lfs, lfs_mdir_t *dir,
         const char **path, uint16_t *id) {
     // we reduce path to a single name if we can find it
@@ -1391,6 +1552,8 @@ nextname:
 
         // find entry matching name
         while (true) {
+            lfs_dircache_skip(lfs, dir->tail, name, namelen, false, NULL);
+
             tag = lfs_dir_fetchmatch(lfs, dir, dir->tail,
                     LFS_MKTAG(0x780, 0, 0),
                     LFS_MKTAG(LFS_TYPE_NAME, 0, namelen),
@@ -1402,6 +1565,11 @@ nextname:
                 return tag;
             }
 
+            int err = lfs_dircache_update(lfs, dir);
+            if (err) {
+                return err;
+            }
+
             if (tag) {
                 break;
             }
@@ -1597,12 +1765,15 @@ static int lfs_dir_commitcrc(lfs_t *lfs, struct lfs_commit *commit) {
 static int lfs_dir_alloc(lfs_t *lfs, lfs_mdir_t *dir) {
     // allocate pair of dir blocks (backwards, so we write block 1 first)
     for (int i = 0; i < 2; i++) {
-        int err = lfs_alloc(lfs, &dir->pair[(i+1)%2]);
+        int err = lfs_alloc(lfs, &dir->pair[(i+1)%2], 1);
         if (err) {
             return err;
         }
     }
 
+    // blocks may have belonged to a since dropped pair
+    lfs_dircache_drop(lfs, dir->pair);
+
     // zero for reproducibility in case initial block is unreadable
     dir->rev = 0;
 
@@ -1890,7 +2061,7 @@ relocate:
         }
 
         // relocate half of pair
-        int err = lfs_alloc(lfs, &dir->pair[1]);
+        int err = lfs_alloc(lfs, &dir->pair[1], 1);
         if (err && (err != LFS_ERR_NOSPC || !tired)) {
             return err;
         }
@@ -2006,6 +2177,16 @@ static int lfs_dir_relocatingcommit(lfs_t *lfs, lfs_mdir_t *dir,
         lfs_mdir_t *pdir) {
     int state = 0;
 
+    // the summary of this pair is about to become stale
+    lfs_dircache_drop(lfs, dir->pair);
+
+    // as are the cached size and retained state until the commit is done
+    lfs->usage = -1;
+    lfs_fs_unretain(lfs);
+
+    // and the position of a walk looking for orphans
+    lfs_fs_deorphanrestart(&lfs->deorphan);
+
     // calculate changes to the directory
     bool hasdelete = false;
     for (int i = 0; i < attrcount; i++) {
@@ -2113,6 +2294,10 @@ compact:
     // fall back to compaction
     lfs_cache_drop(lfs, &lfs->pcache);
 
+    // compaction may split or relocate pairs, which changes the tails
+    // of other pairs as well
+    lfs_dircache_reset(lfs);
+
     state = lfs_dir_splittingcompact(lfs, dir, attrs, attrcount,
             dir, 0, dir->count);
     if (state < 0) {
@@ -2166,6 +2351,7 @@ fixmlist:;
         }
     }
 
+    lfs_fs_retain(lfs);
     return state;
 }
 #endif
@@ -2617,6 +2803,72 @@ static int lfs_dir_rawseek(lfs_t *lfs, lfs_dir_t *dir, lfs_off_t off) {
     return 0;
 }
 
+static int lfs_dir_prefix_match(void *data,
+        lfs_tag_t tag, const void *buffer) {
+    struct lfs_dir_find_match *name = data;
+    lfs_t *lfs = name->lfs;
+    const struct lfs_diskoff *disk = buffer;
+
+    // compare with disk, names starting with our prefix never match
+    // but sort as greater, so we end up in front of them
+    lfs_size_t diff = lfs_min(name->size, lfs_tag_size(tag));
+    int res = lfs_bd_cmp(lfs,
+            NULL, &lfs->rcache, diff,
+            disk->block, disk->off, name->name, diff);
+    if (res != LFS_CMP_EQ) {
+        return res;
+    }
+
+    return LFS_CMP_GT;
+}
+
+static int lfs_dir_rawseekmatch(lfs_t *lfs, lfs_dir_t *dir,
+        const char *name, bool prefix) {
+    lfs_size_t namelen = strlen(name);
+    if (namelen > lfs->name_max) {
+        return LFS_ERR_NAMETOOLONG;
+    }
+
+    // superblock entry is not counted by seek/tell
+    lfs_off_t first = (lfs_pair_cmp(dir->head, lfs->root) == 0);
+    lfs_off_t ids = 0;
+    lfs_block_t tail[2] = {dir->head[0], dir->head[1]};
+
+    while (true) {
+        lfs_dircache_skip(lfs, tail, name, namelen, prefix, &ids);
+
+        // entries are kept sorted across the metadata pairs of a directory,
+        // so we can match during the fetch and stop at the first pair that
+        // contains an entry sorting at or after name
+        uint16_t id;
+        // the mask only matches the file and directory name types, which
+        // leaves out the superblock entry (LFS_TYPE_SUPERBLOCK) of the root
+        lfs_stag_t tag = lfs_dir_fetchmatch(lfs, &dir->m, tail,
+                LFS_MKTAG(0x780, 0, 0),
+                LFS_MKTAG(LFS_TYPE_NAME, 0, namelen),
+                &id, prefix ? lfs_dir_prefix_match : lfs_dir_find_match,
+                &(struct lfs_dir_find_match){lfs, name, namelen});
+        if (tag < 0 && tag != LFS_ERR_NOENT) {
+            return tag;
+        }
+
+        int err = lfs_dircache_update(lfs, &dir->m);
+        if (err) {
+            return err;
+        }
+
+        if (tag != 0 || !dir->m.split) {
+            dir->id = id;
+            dir->pos = 2 + lfs_max(ids + id, first) - first;
+            return (tag > 0);
+        }
+
+        ids += dir->m.count;
+        tail[0] = dir->m.tail[0];
+        tail[1] = dir->m.tail[1];
+    }
+}
+
 static lfs_soff_t lfs_dir_rawtell(lfs_t *lfs, lfs_dir_t *dir) {
     (void)lfs;
     return dir->pos;
@@ -2686,12 +2938,12 @@ static int lfs_ctz_find(lfs_t *lfs,
 #ifndef LFS_READONLY
 static int lfs_ctz_extend(lfs_t *lfs,
         lfs_cache_t *pcache, lfs_cache_t *rcache,
-        lfs_block_t head, lfs_size_t size,
+        lfs_block_t head, lfs_size_t size, lfs_size_t count,
         lfs_block_t *block, lfs_off_t *off) {
     while (true) {
         // go ahead and grab a block
         lfs_block_t nblock;
-        int err = lfs_alloc(lfs, &nblock);
+        int err = lfs_alloc(lfs, &nblock, count);
         if (err) {
             return err;
         }
@@ -3027,7 +3279,7 @@ static int lfs_file_relocate(lfs_t *lfs, lfs_file_t *file) {
     while (true) {
         // just relocate what exists into new block
         lfs_block_t nblock;
-        int err = lfs_alloc(lfs, &nblock);
+        int err = lfs_alloc(lfs, &nblock, 1);
         if (err) {
             return err;
         }
@@ -3223,6 +3475,14 @@ static int lfs_file_rawsync(lfs_t *lfs, lfs_file_t *file) {
             size = sizeof(ctz);
         }
 
+        // the file may have been opened before a checkpoint was written,
+        // which has to go together with any pending orphans and moves
+        err = lfs_fs_forceconsistency(lfs);
+        if (err) {
+            file->flags |= LFS_F_ERRED;
+            return err;
+        }
+
         // commit file data and attributes
         err = lfs_dir_commit(lfs, &file->m, LFS_MKATTRS(
                 {LFS_MKTAG(type, file->id, size), buffer},
@@ -3318,6 +3578,70 @@ static lfs_ssize_t lfs_file_rawread(lfs_t *lfs, lfs_file_t *file,
     return lfs_file_flushedread(lfs, file, buffer, size);
 }
 
+static lfs_ssize_t lfs_file_rawmapread(lfs_t *lfs, lfs_file_t *file,
+        lfs_block_t *block, lfs_off_t *off, lfs_size_t size) {
+    LFS_ASSERT((file->flags & LFS_O_RDONLY) == LFS_O_RDONLY);
+
+#ifndef LFS_READONLY
+    if (file->flags & LFS_F_WRITING) {
+        // flush out any writes
+        int err = lfs_file_flush(lfs, file);
+        if (err) {
+            return err;
+        }
+    }
+#endif
+
+    if (file->pos >= file->ctz.size) {
+        // eof if past end
+        return 0;
+    }
+
+    size = lfs_min(size, file->ctz.size - file->pos);
+
+    // find the block at the current position, same as a read
+    if (!(file->flags & LFS_F_READING) ||
+            file->off == lfs->cfg->block_size) {
+        if (!(file->flags & LFS_F_INLINE)) {
+            int err = lfs_ctz_find(lfs, NULL, &file->cache,
+                    file->ctz.head, file->ctz.size,
+                    file->pos, &file->block, &file->off);
+            if (err) {
+                return err;
+            }
+        } else {
+            file->block = LFS_BLOCK_INLINE;
+            file->off = file->pos;
+        }
+
+        file->flags |= LFS_F_READING;
+    }
+
+    // inline data is held in the file's cache since opening the file, but
+    // only up to cache_size bytes of it, e.g. not all of a file written with
+    // a larger cache_size, and reads may have moved the cached window
+    if (file->flags & LFS_F_INLINE) {
+        LFS_ASSERT(file->cache.block == LFS_BLOCK_INLINE);
+        if (file->off < file->cache.off ||
+                file->off >= file->cache.off + file->cache.size) {
+            return LFS_ERR_NOTSUP;
+        }
+
+        size = lfs_min(size, file->cache.off + file->cache.size - file->off);
+    }
+
+    // never past the end of the current block
+    size = lfs_min(size, lfs->cfg->block_size - file->off);
+    *block = file->block;
+    *off = (file->flags & LFS_F_INLINE)
+            ? file->off - file->cache.off
+            : file->off;
+
+    file->pos += size;
+    file->off += size;
+    return size;
+}
+
 
 #ifndef LFS_READONLY
 static lfs_ssize_t lfs_file_flushedwrite(lfs_t *lfs, lfs_file_t *file,
@@ -3358,10 +3682,12 @@ static lfs_ssize_t lfs_file_flushedwrite(lfs_t *lfs, lfs_file_t *file,
                     lfs_cache_zero(lfs, &file->cache);
                 }
 
-                // extend file with new blocks
+                // extend file with new blocks, about as many as the rest
+                // of this write fills
                 lfs_alloc_ack(lfs);
                 int err = lfs_ctz_extend(lfs, &file->cache, &lfs->rcache,
                         file->block, file->pos,
+                        1 + (nsize-1) / lfs->cfg->block_size,
                         &file->block, &file->off);
                 if (err) {
                     file->flags |= LFS_F_ERRED;
@@ -3835,7 +4161,11 @@ static lfs_ssize_t lfs_rawgetattr(lfs_t *lfs, const char *path,
 
     uint16_t id = lfs_tag_id(tag);
     if (id == 0x3ff) {
-        // special case for root
+        // special case for root, which holds the mount checkpoint
+        if (type == LFS_CHECKPOINT_ATTR) {
+            return LFS_ERR_INVAL;
+        }
+
         id = 0;
         int err = lfs_dir_fetch(lfs, &cwd, lfs->root);
         if (err) {
@@ -3861,6 +4191,11 @@ static lfs_ssize_t lfs_rawgetattr(lfs_t *lfs, const char *path,
 #ifndef LFS_READONLY
 static int lfs_commitattr(lfs_t *lfs, const char *path,
         uint8_t type, const void *buffer, lfs_size_t size) {
+    int err = lfs_fs_forceconsistency(lfs);
+    if (err) {
+        return err;
+    }
+
     lfs_mdir_t cwd;
     lfs_stag_t tag = lfs_dir_find(lfs, &cwd, &path, NULL);
     if (tag < 0) {
@@ -3869,9 +4204,13 @@ static int lfs_commitattr(lfs_t *lfs, const char *path,
 
     uint16_t id = lfs_tag_id(tag);
     if (id == 0x3ff) {
-        // special case for root
+        // special case for root, which holds the mount checkpoint
+        if (type == LFS_CHECKPOINT_ATTR) {
+            return LFS_ERR_INVAL;
+        }
+
         id = 0;
-        int err = lfs_dir_fetch(lfs, &cwd, lfs->root);
+        err = lfs_dir_fetch(lfs, &cwd, lfs->root);
         if (err) {
             return err;
         }
@@ -3960,6 +4299,7 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
     LFS_ASSERT(lfs->cfg->lookahead_size > 0);
     LFS_ASSERT(lfs->cfg->lookahead_size % 8 == 0 &&
             (uintptr_t)lfs->cfg->lookahead_buffer % 4 == 0);
+    LFS_ASSERT((uintptr_t)lfs->cfg->retained_buffer % 4 == 0);
     if (lfs->cfg->lookahead_buffer) {
         lfs->free.buffer = lfs->cfg->lookahead_buffer;
     } else {
@@ -3970,6 +4310,31 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
         }
     }
 
+    // setup directory cache, if enabled
+    if (lfs->cfg->dircache_size) {
+        if (lfs->cfg->dircache_buffer) {
+            lfs->dircache = lfs->cfg->dircache_buffer;
+        } else {
+            lfs->dircache = lfs_malloc(
+                    lfs->cfg->dircache_size*sizeof(lfs_dircache_t));
+            if (!lfs->dircache) {
+                err = LFS_ERR_NOMEM;
+                goto cleanup;
+            }
+        }
+        lfs_dircache_reset(lfs);
+    }
+
+    lfs->compact_pos = 0;
+    lfs->checkpointed = false;
+    lfs->usage = -1;
+    lfs->retained = NULL;
+    lfs->deorphan.found = 0;
+    lfs_fs_deorphanrestart(&lfs->deorphan);
+    lfs->mdir_count = 0;
+    lfs->erased.block = 0;
+    lfs->erased.mask = 0;
+
     // check that the size limits are sane
     LFS_ASSERT(lfs->cfg->name_max <= LFS_NAME_MAX);
     lfs->name_max = lfs->cfg->name_max;
@@ -3991,6 +4356,15 @@ static int lfs_init(lfs_t *lfs, const struct lfs_config *cfg) {
 
     LFS_ASSERT(lfs->cfg->metadata_max <= lfs->cfg->block_size);
 
+    // compacted pairs are filled up to half, a threshold below that would
+    // have lfs_fs_compact compact the same pairs over and over
+    LFS_ASSERT(!lfs->cfg->compact_thresh
+            || lfs->cfg->compact_thresh > (lfs->cfg->metadata_max
+                ? lfs->cfg->metadata_max : lfs->cfg->block_size)/2);
+    LFS_ASSERT(!lfs->cfg->compact_thresh
+            || lfs->cfg->compact_thresh <= (lfs->cfg->metadata_max
+                ? lfs->cfg->metadata_max : lfs->cfg->block_size));
+
     // setup default state
     lfs->root[0] = LFS_BLOCK_NULL;
     lfs->root[1] = LFS_BLOCK_NULL;
@@ -4024,6 +4398,10 @@ static int lfs_deinit(lfs_t *lfs) {
         lfs_free(lfs->free.buffer);
     }
 
+    if (lfs->cfg->dircache_size && !lfs->cfg->dircache_buffer) {
+        lfs_free(lfs->dircache);
+    }
+
     return 0;
 }
 
@@ -4036,6 +4414,19 @@ static int lfs_rawformat(lfs_t *lfs, const struct lfs_config *cfg) {
             return err;
         }
 
+        // start from a blank device if it can be erased at once
+        if (lfs->cfg->erase_range) {
+            err = lfs->cfg->erase_range(lfs->cfg, 0, lfs->cfg->block_count);
+            LFS_ASSERT(err <= 0);
+            if (err) {
+                goto cleanup;
+            }
+
+            lfs->erased.block = 0;
+            lfs->erased.mask = (lfs->cfg->block_count < 32)
+                    ? (1U << lfs->cfg->block_count) - 1 : 0xffffffff;
+        }
+
         // create free lookahead
         memset(lfs->free.buffer, 0, lfs->cfg->lookahead_size);
         lfs->free.off = 0;
@@ -4099,6 +4490,12 @@ static int lfs_rawmount(lfs_t *lfs, const struct lfs_config *cfg) {
         return err;
     }
 
+    // state retained by a previous mount? then nothing needs to be scanned
+    if (lfs_fs_resume(lfs)) {
+        lfs->retained = lfs->cfg->retained_buffer;
+        return 0;
+    }
+
     // scan directory blocks for superblock and any global updates
     lfs_mdir_t dir = {.tail = {0, 1}};
     lfs_block_t cycle = 0;
@@ -4197,6 +4594,19 @@ static int lfs_rawmount(lfs_t *lfs, const struct lfs_config *cfg) {
                 err = LFS_ERR_INVAL;
                 goto cleanup;
             }
+
+            // valid mount checkpoint? then nothing was committed since it
+            // was written and the remaining metadata pairs need no scan
+            int res = lfs_fs_getcheckpoint(lfs, &dir, &lfs->gstate);
+            if (res < 0) {
+                err = res;
+                goto cleanup;
+            }
+
+            if (res) {
+                lfs->checkpointed = true;
+                break;
+            }
         }
 
         // has gstate?
@@ -4206,6 +4616,9 @@ static int lfs_rawmount(lfs_t *lfs, const struct lfs_config *cfg) {
         }
     }
 
+    // a checkpoint leaves the remaining pairs uncounted
+    lfs->mdir_count = lfs->checkpointed ? 0 : cycle;
+
     // found superblock?
     if (lfs_pair_isnull(lfs->root)) {
         err = LFS_ERR_INVAL;
@@ -4227,6 +4640,10 @@ static int lfs_rawmount(lfs_t *lfs, const struct lfs_config *cfg) {
     lfs->free.off = lfs->seed % lfs->cfg->block_count;
     lfs_alloc_drop(lfs);
 
+    // keep what we found across soft resets
+    lfs->retained = lfs->cfg->retained_buffer;
+    lfs_fs_retain(lfs);
+
     return 0;
 
 cleanup:
@@ -4476,139 +4893,187 @@ static int lfs_fs_demove(lfs_t *lfs) {
 }
 #endif
 
+static void lfs_fs_deorphanrestart(struct lfs_deorphan *walk) {
+    // note the orphans found so far stay counted
+    walk->pdir = (lfs_mdir_t){.split = true, .tail = {0, 1}};
+    walk->checked = 0;
+}
+
 #ifndef LFS_READONLY
-static int lfs_fs_deorphan(lfs_t *lfs, bool powerloss) {
-    if (!lfs_gstate_hasorphans(&lfs->gstate)) {
-        return 0;
+// checks the metadata pair following walk->pdir, returns true while there
+// are pairs left to check
+static int lfs_fs_deorphanstep(lfs_t *lfs, bool powerloss,
+        struct lfs_deorphan *walk) {
+    // walked all pairs?
+    if (lfs_pair_isnull(walk->pdir.tail)) {
+        // after a power loss every orphan has been found, so clear the count
+        // even if it was off, instead of walking again on every write
+        lfs_size_t found = powerloss
+                ? lfs_gstate_getorphans(&lfs->gstate)
+                : lfs_min(lfs_gstate_getorphans(&lfs->gstate), walk->found);
+        walk->found = 0;
+        lfs_fs_deorphanrestart(walk);
+
+        // mark orphans as fixed
+        int err = lfs_fs_preporphans(lfs, -(int)found);
+        if (err) {
+            return err;
+        }
+
+        return false;
     }
 
-    int8_t found = 0;
-restart:
-    {
-        // Fix any orphans
-        lfs_mdir_t pdir = {.split = true, .tail = {0, 1}};
-        lfs_mdir_t dir;
+    // our own commits restart the walk as any other commit, undo that unless
+    // they created more orphans
+    lfs_mdir_t pdir = walk->pdir;
+    lfs_size_t checked = walk->checked;
+    lfs_mdir_t dir;
+    int err = lfs_dir_fetch(lfs, &dir, pdir.tail);
+    if (err) {
+        return err;
+    }
+
+    // check head blocks for orphans
+    if (!pdir.split) {
+        // check if we have a parent
+        lfs_mdir_t parent;
+        lfs_stag_t tag = lfs_fs_parent(lfs, pdir.tail, &parent);
+        if (tag < 0 && tag != LFS_ERR_NOENT) {
+            return tag;
+        }
 
-        // iterate over all directory directory entries
-        while (!lfs_pair_isnull(pdir.tail)) {
-            int err = lfs_dir_fetch(lfs, &dir, pdir.tail);
+        // note we only check for full orphans if we may have had a
+        // power-loss, otherwise orphans are created intentionally
+        // during operations such as lfs_mkdir
+        if (tag == LFS_ERR_NOENT && powerloss) {
+            // we are an orphan
+            LFS_DEBUG("Fixing orphan {0x%"PRIx32", 0x%"PRIx32"}",
+                    pdir.tail[0], pdir.tail[1]);
+
+            // steal state
+            err = lfs_dir_getgstate(lfs, &dir, &lfs->gdelta);
             if (err) {
                 return err;
             }
 
-            // check head blocks for orphans
-            if (!pdir.split) {
-                // check if we have a parent
-                lfs_mdir_t parent;
-                lfs_stag_t tag = lfs_fs_parent(lfs, pdir.tail, &parent);
-                if (tag < 0 && tag != LFS_ERR_NOENT) {
-                    return tag;
-                }
-
-                // note we only check for full orphans if we may have had a
-                // power-loss, otherwise orphans are created intentionally
-                // during operations such as lfs_mkdir
-                if (tag == LFS_ERR_NOENT && powerloss) {
-                    // we are an orphan
-                    LFS_DEBUG("Fixing orphan {0x%"PRIx32", 0x%"PRIx32"}",
-                            pdir.tail[0], pdir.tail[1]);
-
-                    // steal state
-                    err = lfs_dir_getgstate(lfs, &dir, &lfs->gdelta);
-                    if (err) {
-                        return err;
-                    }
+            // steal tail
+            lfs_pair_tole32(dir.tail);
+            int state = lfs_dir_orphaningcommit(lfs, &pdir, LFS_MKATTRS(
+                    {LFS_MKTAG(LFS_TYPE_TAIL + dir.split, 0x3ff, 8),
+                        dir.tail}));
+            lfs_pair_fromle32(dir.tail);
+            if (state < 0) {
+                return state;
+            }
 
-                    // steal tail
-                    lfs_pair_tole32(dir.tail);
-                    int state = lfs_dir_orphaningcommit(lfs, &pdir, LFS_MKATTRS(
-                            {LFS_MKTAG(LFS_TYPE_TAIL + dir.split, 0x3ff, 8),
-                                dir.tail}));
-                    lfs_pair_fromle32(dir.tail);
-                    if (state < 0) {
-                        return state;
-                    }
+            walk->found += 1;
 
-                    found += 1;
+            // did our commit create more orphans? otherwise refetch tail
+            if (state == LFS_OK_ORPHANED) {
+                lfs_fs_deorphanrestart(walk);
+            } else {
+                walk->pdir = pdir;
+                walk->checked = checked;
+            }
+            return true;
+        }
 
-                    // did our commit create more orphans?
-                    if (state == LFS_OK_ORPHANED) {
-                        goto restart;
-                    }
+        if (tag != LFS_ERR_NOENT) {
+            lfs_block_t pair[2];
+            lfs_stag_t state = lfs_dir_get(lfs, &parent,
+                    LFS_MKTAG(0x7ff, 0x3ff, 0), tag, pair);
+            if (state < 0) {
+                return state;
+            }
+            lfs_pair_fromle32(pair);
 
-                    // refetch tail
-                    continue;
+            if (!lfs_pair_sync(pair, pdir.tail)) {
+                // we have desynced
+                LFS_DEBUG("Fixing half-orphan "
+                        "{0x%"PRIx32", 0x%"PRIx32"} "
+                        "-> {0x%"PRIx32", 0x%"PRIx32"}",
+                        pdir.tail[0], pdir.tail[1], pair[0], pair[1]);
+
+                // fix pending move in this pair? this looks like an
+                // optimization but is in fact _required_ since
+                // relocating may outdate the move.
+                uint16_t moveid = 0x3ff;
+                if (lfs_gstate_hasmovehere(&lfs->gstate, pdir.pair)) {
+                    moveid = lfs_tag_id(lfs->gstate.tag);
+                    LFS_DEBUG("Fixing move while fixing orphans "
+                            "{0x%"PRIx32", 0x%"PRIx32"} 0x%"PRIx16"\n",
+                            pdir.pair[0], pdir.pair[1], moveid);
+                    lfs_fs_prepmove(lfs, 0x3ff, NULL);
                 }
 
-                if (tag != LFS_ERR_NOENT) {
-                    lfs_block_t pair[2];
-                    lfs_stag_t state = lfs_dir_get(lfs, &parent,
-                            LFS_MKTAG(0x7ff, 0x3ff, 0), tag, pair);
-                    if (state < 0) {
-                        return state;
-                    }
-                    lfs_pair_fromle32(pair);
-
-                    if (!lfs_pair_sync(pair, pdir.tail)) {
-                        // we have desynced
-                        LFS_DEBUG("Fixing half-orphan "
-                                "{0x%"PRIx32", 0x%"PRIx32"} "
-                                "-> {0x%"PRIx32", 0x%"PRIx32"}",
-                                pdir.tail[0], pdir.tail[1], pair[0], pair[1]);
-
-                        // fix pending move in this pair? this looks like an
-                        // optimization but is in fact _required_ since
-                        // relocating may outdate the move.
-                        uint16_t moveid = 0x3ff;
-                        if (lfs_gstate_hasmovehere(&lfs->gstate, pdir.pair)) {
-                            moveid = lfs_tag_id(lfs->gstate.tag);
-                            LFS_DEBUG("Fixing move while fixing orphans "
-                                    "{0x%"PRIx32", 0x%"PRIx32"} 0x%"PRIx16"\n",
-                                    pdir.pair[0], pdir.pair[1], moveid);
-                            lfs_fs_prepmove(lfs, 0x3ff, NULL);
-                        }
-
-                        lfs_pair_tole32(pair);
-                        state = lfs_dir_orphaningcommit(lfs, &pdir, LFS_MKATTRS(
-                                {LFS_MKTAG_IF(moveid != 0x3ff,
-                                    LFS_TYPE_DELETE, moveid, 0), NULL},
-                                {LFS_MKTAG(LFS_TYPE_SOFTTAIL, 0x3ff, 8),
-                                    pair}));
-                        lfs_pair_fromle32(pair);
-                        if (state < 0) {
-                            return state;
-                        }
-
-                        found += 1;
+                lfs_pair_tole32(pair);
+                state = lfs_dir_orphaningcommit(lfs, &pdir, LFS_MKATTRS(
+                        {LFS_MKTAG_IF(moveid != 0x3ff,
+                            LFS_TYPE_DELETE, moveid, 0), NULL},
+                        {LFS_MKTAG(LFS_TYPE_SOFTTAIL, 0x3ff, 8),
+                            pair}));
+                lfs_pair_fromle32(pair);
+                if (state < 0) {
+                    return state;
+                }
 
-                        // did our commit create more orphans?
-                        if (state == LFS_OK_ORPHANED) {
-                            goto restart;
-                        }
+                walk->found += 1;
 
-                        // refetch tail
-                        continue;
-                    }
+                // did our commit create more orphans? otherwise refetch tail
+                if (state == LFS_OK_ORPHANED) {
+                    lfs_fs_deorphanrestart(walk);
+                } else {
+                    walk->pdir = pdir;
+                    walk->checked = checked;
                 }
+                return true;
             }
-
-            pdir = dir;
         }
     }
 
-    // mark orphans as fixed
-    return lfs_fs_preporphans(lfs, -lfs_min(
-            lfs_gstate_getorphans(&lfs->gstate),
-            found));
+    walk->pdir = dir;
+    walk->checked += 1;
+    return true;
 }
 #endif
 
 #ifndef LFS_READONLY
-static int lfs_fs_forceconsistency(lfs_t *lfs) {
-    int err = lfs_fs_demove(lfs);
-    if (err) {
-        return err;
-    }
+static int lfs_fs_deorphan(lfs_t *lfs, bool powerloss) {
+    if (!lfs_gstate_hasorphans(&lfs->gstate)) {
+        return 0;
+    }
+
+    // after a power loss, continue the walk lfs_fs_mkconsistent may have
+    // started, orphans created by a failing commit are found on the way
+    struct lfs_deorphan local = {.found = 0};
+    lfs_fs_deorphanrestart(&local);
+    struct lfs_deorphan *walk = powerloss ? &lfs->deorphan : &local;
+
+    while (true) {
+        int res = lfs_fs_deorphanstep(lfs, powerloss, walk);
+        if (res < 0) {
+            return res;
+        }
+
+        if (!res) {
+            return 0;
+        }
+    }
+}
+#endif
+
+#ifndef LFS_READONLY
+static int lfs_fs_forceconsistency(lfs_t *lfs) {
+    // every metadata commit follows this, so the mount checkpoint has to go
+    int err = lfs_fs_uncheckpoint(lfs);
+    if (err) {
+        return err;
+    }
+
+    err = lfs_fs_demove(lfs);
+    if (err) {
+        return err;
+    }
 
     err = lfs_fs_deorphan(lfs, true);
     if (err) {
@@ -4627,15 +5092,423 @@ static int lfs_fs_size_count(void *p, lfs_block_t block) {
 }
 
 static lfs_ssize_t lfs_fs_rawsize(lfs_t *lfs) {
+    // open files may hold blocks which are not committed yet, so the size
+    // is only cached while none are open
+    bool cacheable = true;
+    for (struct lfs_mlist *d = lfs->mlist; d; d = d->next) {
+        if (d->type == LFS_TYPE_REG) {
+            cacheable = false;
+            break;
+        }
+    }
+
+    if (cacheable && lfs->usage >= 0) {
+        return lfs->usage;
+    }
+
     lfs_size_t size = 0;
     int err = lfs_fs_rawtraverse(lfs, lfs_fs_size_count, &size, false);
     if (err) {
         return err;
     }
 
+    if (cacheable) {
+        lfs->usage = size;
+        lfs_fs_retain(lfs);
+    }
+
     return size;
 }
 
+#ifndef LFS_READONLY
+static int lfs_fs_rawcompact(lfs_t *lfs) {
+    lfs_size_t end = lfs->cfg->metadata_max
+            ? lfs->cfg->metadata_max : lfs->cfg->block_size;
+    lfs_size_t thresh = lfs->cfg->compact_thresh
+            ? lfs->cfg->compact_thresh : end - end/4;
+
+    // compaction commits, so pending orphans and moves have to go first
+    int err = lfs_fs_forceconsistency(lfs);
+    if (err) {
+        return err;
+    }
+
+    // walk the metadata pairs, resuming at the position of the last call
+    // and wrapping around once, so false means no pair needs compacting
+    lfs_mdir_t mdir = {.tail = {0, 1}};
+    bool wrapped = false;
+    for (lfs_size_t pos = 0; !wrapped || pos < lfs->compact_pos; pos++) {
+        if (lfs_pair_isnull(mdir.tail)) {
+            if (wrapped || lfs->compact_pos == 0) {
+                break;
+            }
+
+            wrapped = true;
+            mdir.tail[0] = 0;
+            mdir.tail[1] = 1;
+            pos = 0;
+        }
+
+        err = lfs_dir_fetch(lfs, &mdir, mdir.tail);
+        if (err) {
+            return err;
+        }
+
+        if ((!wrapped && pos < lfs->compact_pos)
+                || (mdir.erased && mdir.off <= thresh)) {
+            continue;
+        }
+
+        // the easiest way to trigger a compaction is to mark the mdir as
+        // unerased and commit nothing
+        mdir.erased = false;
+        err = lfs_dir_commit(lfs, &mdir, NULL, 0);
+        if (err) {
+            return err;
+        }
+
+        lfs->compact_pos = pos + 1;
+        return true;
+    }
+
+    lfs->compact_pos = 0;
+    return false;
+}
+#endif
+
+#ifndef LFS_READONLY
+static int lfs_fs_rawmkconsistent(lfs_t *lfs) {
+    lfs_gstate_t delta = {0};
+    lfs_gstate_xor(&delta, &lfs->gdisk);
+    lfs_gstate_xor(&delta, &lfs->gstate);
+    if (!lfs_gstate_hasorphans(&lfs->gstate)
+            && !lfs_gstate_hasmove(&lfs->gdisk)
+            && lfs_gstate_iszero(&delta)) {
+        return false;
+    }
+
+    // as in lfs_fs_forceconsistency, the mount checkpoint goes first
+    int err = lfs_fs_uncheckpoint(lfs);
+    if (err) {
+        return err;
+    }
+
+    // one step at a time, starting with a pending move
+    if (lfs_gstate_hasmove(&lfs->gdisk)) {
+        err = lfs_fs_demove(lfs);
+        if (err) {
+            return err;
+        }
+
+        return true;
+    }
+
+    if (lfs_gstate_hasorphans(&lfs->gstate)) {
+        int res = lfs_fs_deorphanstep(lfs, true, &lfs->deorphan);
+        if (res < 0) {
+            return res;
+        }
+
+        return true;
+    }
+
+    // do we still have any pending gstate?
+    delta = (lfs_gstate_t){0};
+    lfs_gstate_xor(&delta, &lfs->gdisk);
+    lfs_gstate_xor(&delta, &lfs->gstate);
+    if (!lfs_gstate_iszero(&delta)) {
+        // lfs_dir_commit will implicitly write out any pending gstate
+        lfs_mdir_t root;
+        err = lfs_dir_fetch(lfs, &root, lfs->root);
+        if (err) {
+            return err;
+        }
+
+        err = lfs_dir_commit(lfs, &root, NULL, 0);
+        if (err) {
+            return err;
+        }
+    }
+
+    return true;
+}
+#endif
+
+#ifndef LFS_READONLY
+static int lfs_fs_rawconsistency(lfs_t *lfs,
+        struct lfs_fsconsistency *consistency) {
+    consistency->move = lfs_gstate_hasmove(&lfs->gdisk);
+    consistency->orphans = lfs_gstate_getorphans(&lfs->gstate);
+    consistency->checked = lfs->deorphan.checked;
+    consistency->count = lfs->mdir_count;
+    return 0;
+}
+#endif
+
+#ifndef LFS_READONLY
+static int lfs_fs_rawprealloc(lfs_t *lfs) {
+    // blocks left in the current lookahead window, or no free blocks at all?
+    if (lfs->free.i != lfs->free.size || lfs->free.ack == 0) {
+        return false;
+    }
+
+    int err = lfs_alloc_scan(lfs);
+    if (err) {
+        return err;
+    }
+
+    return true;
+}
+#endif
+
+#ifndef LFS_READONLY
+static int lfs_fs_rawallocseek(lfs_t *lfs, lfs_block_t block) {
+    if (block >= lfs->cfg->block_count) {
+        return LFS_ERR_INVAL;
+    }
+
+    // the next scan starts at block
+    lfs->free.off = block;
+    lfs_alloc_drop(lfs);
+    return 0;
+}
+#endif
+
+/// Mount checkpoints ///
+typedef struct lfs_checkpoint {
+    uint32_t magic;
+    lfs_size_t block_size;
+    lfs_size_t block_count;
+    uint32_t rev;
+    lfs_off_t off;
+    lfs_gstate_t gstate;
+    uint32_t crc;
+} lfs_checkpoint_t;
+
+#define LFS_CHECKPOINT_MAGIC 0x5043464c // "LFCP"
+
+#ifndef LFS_READONLY
+static void lfs_checkpoint_tole32(lfs_checkpoint_t *checkpoint) {
+    checkpoint->magic       = lfs_tole32(checkpoint->magic);
+    checkpoint->block_size  = lfs_tole32(checkpoint->block_size);
+    checkpoint->block_count = lfs_tole32(checkpoint->block_count);
+    checkpoint->rev         = lfs_tole32(checkpoint->rev);
+    checkpoint->off         = lfs_tole32(checkpoint->off);
+    lfs_gstate_tole32(&checkpoint->gstate);
+}
+#endif
+
+static void lfs_checkpoint_fromle32(lfs_checkpoint_t *checkpoint) {
+    checkpoint->magic       = lfs_fromle32(checkpoint->magic);
+    checkpoint->block_size  = lfs_fromle32(checkpoint->block_size);
+    checkpoint->block_count = lfs_fromle32(checkpoint->block_count);
+    checkpoint->rev         = lfs_fromle32(checkpoint->rev);
+    checkpoint->off         = lfs_fromle32(checkpoint->off);
+    lfs_gstate_fromle32(&checkpoint->gstate);
+}
+
+static int lfs_fs_getcheckpoint(lfs_t *lfs, const lfs_mdir_t *dir,
+        lfs_gstate_t *gstate) {
+    lfs_checkpoint_t checkpoint;
+    lfs_stag_t tag = lfs_dir_get(lfs, dir, LFS_MKTAG(0x7ff, 0x3ff, 0),
+            LFS_MKTAG(LFS_TYPE_USERATTR + LFS_CHECKPOINT_ATTR, 0,
+                sizeof(checkpoint)), &checkpoint);
+    if (tag < 0) {
+        return (tag == LFS_ERR_NOENT) ? false : tag;
+    }
+
+    if (lfs_tag_size(tag) != sizeof(checkpoint) ||
+            lfs_fromle32(checkpoint.crc) != lfs_crc(0xffffffff,
+                &checkpoint, sizeof(checkpoint) - sizeof(checkpoint.crc))) {
+        return false;
+    }
+
+    // drivers unaware of checkpoints keep the attribute through their
+    // commits and compactions, so the checkpoint only counts if its commit
+    // is still the last one of the root pair
+    lfs_checkpoint_fromle32(&checkpoint);
+    if (checkpoint.magic != LFS_CHECKPOINT_MAGIC ||
+            checkpoint.block_size != lfs->cfg->block_size ||
+            checkpoint.block_count != lfs->cfg->block_count ||
+            checkpoint.rev != dir->rev ||
+            checkpoint.off != dir->off) {
+        return false;
+    }
+
+    *gstate = checkpoint.gstate;
+    return true;
+}
+
+#ifndef LFS_READONLY
+static int lfs_fs_uncheckpoint(lfs_t *lfs) {
+    if (!lfs->checkpointed) {
+        return 0;
+    }
+
+    lfs_mdir_t root;
+    int err = lfs_dir_fetch(lfs, &root, lfs->root);
+    if (err) {
+        return err;
+    }
+
+    err = lfs_dir_commit(lfs, &root, LFS_MKATTRS(
+            {LFS_MKTAG(LFS_TYPE_USERATTR + LFS_CHECKPOINT_ATTR, 0, 0x3ff),
+                NULL}));
+    if (err) {
+        return err;
+    }
+
+    lfs->checkpointed = false;
+    return 0;
+}
+#endif
+
+#ifndef LFS_READONLY
+static int lfs_fs_rawcheckpoint(lfs_t *lfs) {
+    if (lfs->checkpointed) {
+        return 0;
+    }
+
+    // as before any other commit, resolve pending orphans and moves
+    int err = lfs_fs_forceconsistency(lfs);
+    if (err) {
+        return err;
+    }
+
+    // the commit writes out any pending gstate, so afterwards the gstate
+    // on disk matches ours, except for the orphan count, which like commits
+    // we leave out, mount derives it from the orphan flag as after a scan
+    lfs_gstate_t gstate = lfs->gstate;
+    gstate.tag &= ~LFS_MKTAG(0, 0, 0x3ff);
+
+    lfs_mdir_t root;
+    err = lfs_dir_fetch(lfs, &root, lfs->root);
+    if (err) {
+        return err;
+    }
+
+    // where the root pair ends up after appending a commit of just the
+    // checkpoint, padded to the program size as in lfs_dir_commitcrc
+    uint32_t rev = root.rev;
+    lfs_off_t off = lfs_alignup(root.off + sizeof(lfs_tag_t)
+            + sizeof(lfs_checkpoint_t) + 2*sizeof(uint32_t),
+            lfs->cfg->prog_size);
+    lfs_checkpoint_t checkpoint = {
+        .magic       = LFS_CHECKPOINT_MAGIC,
+        .block_size  = lfs->cfg->block_size,
+        .block_count = lfs->cfg->block_count,
+        .rev         = rev,
+        .off         = off,
+        .gstate      = gstate,
+    };
+    lfs_checkpoint_tole32(&checkpoint);
+    checkpoint.crc = lfs_tole32(lfs_crc(0xffffffff,
+            &checkpoint, sizeof(checkpoint) - sizeof(checkpoint.crc)));
+
+    // a failed commit may still have reached the disk, so from here on the
+    // checkpoint has to be removed before any other commit
+    lfs->checkpointed = true;
+    err = lfs_dir_commit(lfs, &root, LFS_MKATTRS(
+            {LFS_MKTAG(LFS_TYPE_USERATTR + LFS_CHECKPOINT_ATTR, 0,
+                sizeof(checkpoint)), &checkpoint}));
+    if (err) {
+        return err;
+    }
+
+    // did the commit itself change the gstate (e.g. by relocating), or
+    // not end where expected (e.g. by compacting)?
+    lfs_gstate_t current = lfs->gstate;
+    current.tag &= ~LFS_MKTAG(0, 0, 0x3ff);
+    if (memcmp(&gstate, &current, sizeof(gstate)) != 0 ||
+            root.rev != rev || root.off != off) {
+        return lfs_fs_uncheckpoint(lfs);
+    }
+
+    return 0;
+}
+#endif
+
+/// Retained state ///
+#define LFS_RETAINED_MAGIC 0x5452464c // "LFRT"
+
+static uint32_t lfs_retained_crc(lfs_t *lfs, const lfs_retained_t *retained) {
+    uint32_t crc = lfs_crc(0xffffffff, retained,
+            sizeof(lfs_retained_t) - sizeof(retained->crc));
+    return lfs_crc(crc, retained+1, lfs->cfg->lookahead_size);
+}
+
+#ifndef LFS_READONLY
+static void lfs_fs_unretain(lfs_t *lfs) {
+    // also covers lfs_format, which never retains anything
+    lfs_retained_t *retained = lfs->cfg->retained_buffer;
+    if (retained) {
+        retained->magic = 0;
+    }
+}
+#endif
+
+static void lfs_fs_retain(lfs_t *lfs) {
+    lfs_retained_t *retained = lfs->retained;
+    if (!retained) {
+        return;
+    }
+
+    // the gstate on disk is what a scan during mount would find, which like
+    // commits leaves out the orphan count and keeps only the orphan flag
+    retained->magic          = LFS_RETAINED_MAGIC;
+    retained->block_size     = lfs->cfg->block_size;
+    retained->block_count    = lfs->cfg->block_count;
+    retained->lookahead_size = lfs->cfg->lookahead_size;
+    retained->root[0]        = lfs->root[0];
+    retained->root[1]        = lfs->root[1];
+    retained->gstate         = lfs->gdisk;
+    retained->gstate.tag    &= ~LFS_MKTAG(0, 0, 0x3ff);
+    retained->name_max       = lfs->name_max;
+    retained->file_max       = lfs->file_max;
+    retained->attr_max       = lfs->attr_max;
+    retained->free_off       = lfs->free.off;
+    retained->free_size      = lfs->free.size;
+    retained->free_i         = lfs->free.i;
+    retained->usage          = lfs->usage;
+    retained->checkpointed   = lfs->checkpointed;
+    memcpy(retained+1, lfs->free.buffer, lfs->cfg->lookahead_size);
+    retained->crc = lfs_retained_crc(lfs, retained);
+}
+
+static bool lfs_fs_resume(lfs_t *lfs) {
+    const lfs_retained_t *retained = lfs->cfg->retained_buffer;
+    if (!retained ||
+            retained->magic != LFS_RETAINED_MAGIC ||
+            retained->block_size != lfs->cfg->block_size ||
+            retained->block_count != lfs->cfg->block_count ||
+            retained->lookahead_size != lfs->cfg->lookahead_size ||
+            retained->crc != lfs_retained_crc(lfs, retained)) {
+        return false;
+    }
+
+    lfs->root[0]      = retained->root[0];
+    lfs->root[1]      = retained->root[1];
+    lfs->gstate       = retained->gstate;
+    lfs->name_max     = retained->name_max;
+    lfs->file_max     = retained->file_max;
+    lfs->attr_max     = retained->attr_max;
+    lfs->usage        = retained->usage;
+    lfs->checkpointed = retained->checkpointed;
+
+    // as in mount, a set orphan flag counts as one orphan
+    lfs->gstate.tag += !lfs_tag_isvalid(lfs->gstate.tag);
+    lfs->gdisk = lfs->gstate;
+
+    // blocks handed out since the lookahead was retained were either
+    // committed, which retained it again, or are unused after the reset
+    lfs->free.off  = retained->free_off;
+    lfs->free.size = retained->free_size;
+    lfs->free.i    = retained->free_i;
+    memcpy(lfs->free.buffer, retained+1, lfs->cfg->lookahead_size);
+    lfs_alloc_ack(lfs);
+    return true;
+}
+
 #ifdef LFS_MIGRATE
 ////// Migration from littelfs v1 below this //////
 
@@ -5364,7 +6237,15 @@ int lfs_unmount(lfs_t *lfs) {
     }
     LFS_TRACE("lfs_unmount(%p)", (void*)lfs);
 
-    err = lfs_rawunmount(lfs);
+#ifndef LFS_READONLY
+    // unmount even if the checkpoint fails, report its error first
+    if (lfs->cfg->mount_checkpoint) {
+        err = lfs_fs_rawcheckpoint(lfs);
+    }
+#endif
+
+    int err2 = lfs_rawunmount(lfs);
+    err = err ? err : err2;
 
     LFS_TRACE("lfs_unmount -> %d", err);
     LFS_UNLOCK(lfs->cfg);
@@ -5554,6 +6435,23 @@ lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
     return res;
 }
 
+lfs_ssize_t lfs_file_mapread(lfs_t *lfs, lfs_file_t *file,
+        lfs_block_t *block, lfs_off_t *off, lfs_size_t size) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_file_mapread(%p, %p, %p, %p, %"PRIu32")",
+            (void*)lfs, (void*)file, (void*)block, (void*)off, size);
+    LFS_ASSERT(lfs_mlist_isopen(lfs->mlist, (struct lfs_mlist*)file));
+
+    lfs_ssize_t res = lfs_file_rawmapread(lfs, file, block, off, size);
+
+    LFS_TRACE("lfs_file_mapread -> %"PRId32, res);
+    LFS_UNLOCK(lfs->cfg);
+    return res;
+}
+
 #ifndef LFS_READONLY
 lfs_ssize_t lfs_file_write(lfs_t *lfs, lfs_file_t *file,
         const void *buffer, lfs_size_t size) {
@@ -5727,6 +6625,36 @@ int lfs_dir_seek(lfs_t *lfs, lfs_dir_t *dir, lfs_off_t off) {
     return err;
 }
 
+int lfs_dir_seekname(lfs_t *lfs, lfs_dir_t *dir, const char *name) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_dir_seekname(%p, %p, \"%s\")",
+            (void*)lfs, (void*)dir, name);
+
+    err = lfs_dir_rawseekmatch(lfs, dir, name, false);
+
+    LFS_TRACE("lfs_dir_seekname -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+
+int lfs_dir_seekprefix(lfs_t *lfs, lfs_dir_t *dir, const char *prefix) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_dir_seekprefix(%p, %p, \"%s\")",
+            (void*)lfs, (void*)dir, prefix);
+
+    err = lfs_dir_rawseekmatch(lfs, dir, prefix, true);
+
+    LFS_TRACE("lfs_dir_seekprefix -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+
 lfs_soff_t lfs_dir_tell(lfs_t *lfs, lfs_dir_t *dir) {
     int err = LFS_LOCK(lfs->cfg);
     if (err) {
@@ -5784,6 +6712,102 @@ int lfs_fs_traverse(lfs_t *lfs, int (*cb)(void *, lfs_block_t), void *data) {
     return err;
 }
 
+#ifndef LFS_READONLY
+int lfs_fs_compact(lfs_t *lfs) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_fs_compact(%p)", (void*)lfs);
+
+    err = lfs_fs_rawcompact(lfs);
+
+    LFS_TRACE("lfs_fs_compact -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
+#ifndef LFS_READONLY
+int lfs_fs_mkconsistent(lfs_t *lfs) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_fs_mkconsistent(%p)", (void*)lfs);
+
+    err = lfs_fs_rawmkconsistent(lfs);
+
+    LFS_TRACE("lfs_fs_mkconsistent -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
+#ifndef LFS_READONLY
+int lfs_fs_consistency(lfs_t *lfs, struct lfs_fsconsistency *consistency) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_fs_consistency(%p, %p)", (void*)lfs, (void*)consistency);
+
+    err = lfs_fs_rawconsistency(lfs, consistency);
+
+    LFS_TRACE("lfs_fs_consistency -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
+#ifndef LFS_READONLY
+int lfs_fs_prealloc(lfs_t *lfs) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_fs_prealloc(%p)", (void*)lfs);
+
+    err = lfs_fs_rawprealloc(lfs);
+
+    LFS_TRACE("lfs_fs_prealloc -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
+#ifndef LFS_READONLY
+int lfs_fs_checkpoint(lfs_t *lfs) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_fs_checkpoint(%p)", (void*)lfs);
+
+    err = lfs_fs_rawcheckpoint(lfs);
+
+    LFS_TRACE("lfs_fs_checkpoint -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
+#ifndef LFS_READONLY
+int lfs_fs_allocseek(lfs_t *lfs, lfs_block_t block) {
+    int err = LFS_LOCK(lfs->cfg);
+    if (err) {
+        return err;
+    }
+    LFS_TRACE("lfs_fs_allocseek(%p, %"PRIu32")", (void*)lfs, block);
+
+    err = lfs_fs_rawallocseek(lfs, block);
+
+    LFS_TRACE("lfs_fs_allocseek -> %d", err);
+    LFS_UNLOCK(lfs->cfg);
+    return err;
+}
+#endif
+
 #ifdef LFS_MIGRATE
 int lfs_migrate(lfs_t *lfs, const struct lfs_config *cfg) {
     int err = LFS_LOCK(cfg);
@@ -68,6 +68,24 @@ typedef uint32_t lfs_block_t;
 #define LFS_ATTR_MAX 1022
 #endif
 
+// Number of name bytes kept per metadata pair by the optional directory
+// cache, may be redefined to trade RAM for fewer metadata fetches with
+// names sharing long prefixes.
+#ifndef LFS_DIRCACHE_NAME
+#define LFS_DIRCACHE_NAME 8
+#endif
+
+// User attribute type on the root directory reserved for mount checkpoints,
+// see lfs_fs_checkpoint. Getting, setting or removing it on the root
+// directory fails with LFS_ERR_INVAL.
+#ifndef LFS_CHECKPOINT_ATTR
+#define LFS_CHECKPOINT_ATTR 0xcf
+#endif
+
+// Block returned by lfs_file_mapread for data of inlined files, which is
+// stored in the metadata pair of its directory.
+#define LFS_BLOCK_INLINE ((lfs_block_t)-2)
+
 // Possible error codes, these are negative to allow
 // valid positive return values
 enum lfs_error {
@@ -86,6 +104,7 @@ enum lfs_error {
     LFS_ERR_NOMEM       = -12,  // No more memory available
     LFS_ERR_NOATTR      = -61,  // No data/attr available
     LFS_ERR_NAMETOOLONG = -36,  // File name too long
+    LFS_ERR_NOTSUP      = -95,  // Operation not supported
 };
 
 // File types
@@ -263,6 +282,44 @@ struct lfs_config {
     // can help bound the metadata compaction time. Must be <= block_size.
     // Defaults to block_size when zero.
     lfs_size_t metadata_max;
+
+    // Optional number of metadata pairs summarized in RAM. Name lookups use
+    // the summaries to step over metadata pairs that only hold entries sorted
+    // in front of the name without fetching them, which bounds the cost of
+    // lookups in large directories. Disabled when zero.
+    lfs_size_t dircache_size;
+
+    // Optional statically allocated directory cache. Must be
+    // dircache_size*sizeof(lfs_dircache_t). By default lfs_malloc is used
+    // to allocate this buffer.
+    void *dircache_buffer;
+
+    // Optional threshold in bytes above which lfs_fs_compact compacts a
+    // metadata pair ahead of time, so the compaction does not happen in the
+    // middle of a later commit. Must be above half of metadata_max (or
+    // block_size) and at most metadata_max, as compacted pairs are filled up
+    // to half. Defaults to 3/4 of metadata_max (or block_size) when zero.
+    lfs_size_t compact_thresh;
+
+    // Optionally write a mount checkpoint on unmount, see lfs_fs_checkpoint.
+    bool mount_checkpoint;
+
+    // Optional buffer of LFS_RETAINED_SIZE(lookahead_size) bytes in RAM which
+    // survives soft resets (e.g. a .noinit section), must be 32-bit aligned.
+    // While mounted, littlefs keeps the state collected by lfs_mount in there,
+    // and lfs_mount resumes from it without touching the storage as long as it
+    // is valid. It has to be cleared if the storage is modified by other
+    // means. Disabled when NULL.
+    void *retained_buffer;
+
+    // Optionally erase count consecutive blocks starting at block, e.g. with
+    // the 64KiB or chip erase command of a part. lfs_format then erases the
+    // whole device at once. When a file write needs several new blocks,
+    // the allocator erases the run of up to that many (at most 32) free
+    // blocks when handing out the first of them. Errors of the latter are
+    // left to the single block erases that follow. May be NULL.
+    int (*erase_range)(const struct lfs_config *c, lfs_block_t block,
+            lfs_size_t count);
 };
 
 // File info structure
@@ -369,6 +426,15 @@ typedef struct lfs_file {
     const struct lfs_file_config *cfg;
 } lfs_file_t;
 
+typedef struct lfs_dircache {
+    lfs_block_t pair[2];
+    lfs_block_t tail[2];
+    uint16_t count;
+    uint16_t namelen;
+    bool split;
+    uint8_t name[LFS_DIRCACHE_NAME];
+} lfs_dircache_t;
+
 typedef struct lfs_superblock {
     uint32_t version;
     lfs_size_t block_size;
@@ -383,6 +449,29 @@ typedef struct lfs_gstate {
     lfs_block_t pair[2];
 } lfs_gstate_t;
 
+typedef struct lfs_retained {
+    uint32_t magic;
+    lfs_size_t block_size;
+    lfs_size_t block_count;
+    lfs_size_t lookahead_size;
+    lfs_block_t root[2];
+    lfs_gstate_t gstate;
+    lfs_size_t name_max;
+    lfs_size_t file_max;
+    lfs_size_t attr_max;
+    lfs_block_t free_off;
+    lfs_block_t free_size;
+    lfs_block_t free_i;
+    lfs_ssize_t usage;
+    uint32_t checkpointed;
+    uint32_t crc;
+    // followed by lookahead_size bytes of the lookahead buffer
+} lfs_retained_t;
+
+// Size of lfs_config.retained_buffer
+#define LFS_RETAINED_SIZE(lookahead_size) \
+    (sizeof(lfs_retained_t) + (lookahead_size))
+
 // The littlefs filesystem type
 typedef struct lfs {
     lfs_cache_t rcache;
@@ -409,6 +498,24 @@ typedef struct lfs {
         uint32_t *buffer;
     } free;
 
+    lfs_dircache_t *dircache;
+    lfs_size_t compact_pos;
+    bool checkpointed;
+    lfs_ssize_t usage;
+    lfs_retained_t *retained;
+
+    struct lfs_deorphan {
+        lfs_mdir_t pdir;
+        lfs_size_t checked;
+        lfs_size_t found;
+    } deorphan;
+    lfs_size_t mdir_count;
+
+    struct lfs_erased {
+        lfs_block_t block;
+        uint32_t mask;
+    } erased;
+
     const struct lfs_config *cfg;
     lfs_size_t name_max;
     lfs_size_t file_max;
@@ -445,7 +552,9 @@ int lfs_mount(lfs_t *lfs, const struct lfs_config *config);
 
 // Unmounts a littlefs
 //
-// Does nothing besides releasing any allocated resources.
+// Does nothing besides releasing any allocated resources, and writing a
+// checkpoint if mount_checkpoint is set. The resources are released even if
+// the checkpoint fails, the error is returned all the same.
 // Returns a negative error code on failure.
 int lfs_unmount(lfs_t *lfs);
 
@@ -563,6 +672,24 @@ int lfs_file_sync(lfs_t *lfs, lfs_file_t *file);
 lfs_ssize_t lfs_file_read(lfs_t *lfs, lfs_file_t *file,
         void *buffer, lfs_size_t size);
 
+// Locate file data on storage instead of reading it
+//
+// Advances the position of the file like lfs_file_read, but instead of
+// copying the data returns where it is stored: 'off' bytes into 'block'.
+// The data is contiguous up to the end of the block, so fewer than 'size'
+// bytes are located at once if the range crosses into the next block. The
+// location is only valid until the file or filesystem is modified.
+//
+// For inlined files 'block' is LFS_BLOCK_INLINE and the data is located at
+// 'off' in the file's cache buffer, which is only valid until the file is
+// read or closed. Only the part of the data held in the cache can be
+// located, e.g. not all of a file written with a larger cache_size, for
+// the rest LFS_ERR_NOTSUP is returned and lfs_file_read has to be used.
+//
+// Returns the number of bytes located, or a negative error code on failure.
+lfs_ssize_t lfs_file_mapread(lfs_t *lfs, lfs_file_t *file,
+        lfs_block_t *block, lfs_off_t *off, lfs_size_t size);
+
 #ifndef LFS_READONLY
 // Write data to file
 //
@@ -643,6 +770,26 @@ int lfs_dir_read(lfs_t *lfs, lfs_dir_t *dir, struct lfs_info *info);
 // Returns a negative error code on failure.
 int lfs_dir_seek(lfs_t *lfs, lfs_dir_t *dir, lfs_off_t off);
 
+// Change the position of the directory to the entry with the specified name
+//
+// Entries are kept in sorted order, so this only fetches the metadata pairs
+// up to the one holding the entry instead of reading every entry in front
+// of it. The next read returns the found entry. If no such entry exists the
+// directory is positioned where the entry would be sorted in.
+//
+// Returns true if an entry with exactly this name exists, false otherwise,
+// or a negative error code on failure.
+int lfs_dir_seekname(lfs_t *lfs, lfs_dir_t *dir, const char *name);
+
+// Change the position of the directory to the first entry whose name starts
+// with the specified prefix
+//
+// All entries sharing a prefix are adjacent in the sorted order, so reading
+// can stop at the first entry not starting with the prefix.
+//
+// Returns a negative error code on failure.
+int lfs_dir_seekprefix(lfs_t *lfs, lfs_dir_t *dir, const char *prefix);
+
 // Return the position of the directory
 //
 // The returned offset is only meant to be consumed by seek and may not make
@@ -662,7 +809,8 @@ int lfs_dir_rewind(lfs_t *lfs, lfs_dir_t *dir);
 // Finds the current size of the filesystem
 //
 // Note: Result is best effort. If files share COW structures, the returned
-// size may be larger than the filesystem actually is.
+// size may be larger than the filesystem actually is. The result is cached
+// while no files are open.
 //
 // Returns the number of allocated blocks, or a negative error code on failure.
 lfs_ssize_t lfs_fs_size(lfs_t *lfs);
@@ -676,6 +824,89 @@ lfs_ssize_t lfs_fs_size(lfs_t *lfs);
 // Returns a negative error code on failure.
 int lfs_fs_traverse(lfs_t *lfs, int (*cb)(void*, lfs_block_t), void *data);
 
+#ifndef LFS_READONLY
+// Compacts the next metadata pair exceeding compact_thresh
+//
+// Each call compacts at most one metadata pair, continuing where the
+// previous call left off, which bounds the work done per call to one
+// compaction. Meant to be called while idle, so commits rarely need to
+// compact in the foreground.
+//
+// Pending orphans and moves are resolved first, as for any other write.
+//
+// Returns true (1) if a metadata pair was compacted, false (0) once all
+// metadata pairs have been checked without finding one to compact, or a
+// negative error code on failure.
+int lfs_fs_compact(lfs_t *lfs);
+
+// Takes one step towards resolving the orphans and moves left behind by a
+// power loss
+//
+// A step resolves the pending move, checks one metadata pair for orphans or
+// writes out the updated global state. Reads never wait for this, but the
+// first write after mounting completes any remaining steps, so calling this
+// while idle keeps the work out of that write. See lfs_fs_consistency for
+// the progress.
+//
+// Returns true (1) if a step was taken, false (0) once the filesystem is
+// consistent, or a negative error code on failure.
+int lfs_fs_mkconsistent(lfs_t *lfs);
+
+// Progress of lfs_fs_mkconsistent
+struct lfs_fsconsistency {
+    // Whether a move interrupted by a power loss is still pending
+    bool move;
+
+    // Number of orphans recorded in the global state
+    lfs_size_t orphans;
+
+    // Number of metadata pairs checked for orphans so far
+    lfs_size_t checked;
+
+    // Number of metadata pairs found by lfs_mount, 0 if it did not scan them
+    lfs_size_t count;
+};
+
+// Reports the work left for lfs_fs_mkconsistent
+//
+// Returns a negative error code on failure.
+int lfs_fs_consistency(lfs_t *lfs, struct lfs_fsconsistency *consistency);
+
+// Populates the lookahead buffer if all of its blocks have been handed out
+//
+// Otherwise the scan of the filesystem for free blocks happens on the next
+// block allocation.
+//
+// Returns true (1) if the lookahead buffer was populated, false (0) if it
+// still holds blocks to allocate, or a negative error code on failure.
+int lfs_fs_prealloc(lfs_t *lfs);
+
+// Writes a mount checkpoint
+//
+// The checkpoint holds the global state otherwise collected by scanning
+// every metadata pair during mount, and is stored as a CRC-protected
+// attribute (type LFS_CHECKPOINT_ATTR) of the root directory. While it is
+// present lfs_mount only fetches the root metadata pair. Any following
+// metadata commit removes the checkpoint first, so a power loss never leaves
+// a stale checkpoint behind. Drivers unaware of checkpoints keep it, so it
+// also records the revision and end of the root pair's last commit, and is
+// ignored by lfs_mount once the root pair has been committed to or compacted
+// since.
+//
+// Returns a negative error code on failure.
+int lfs_fs_checkpoint(lfs_t *lfs);
+
+// Restarts the search for free blocks at the given block
+//
+// Blocks are handed out in ascending order from there, wrapping around at
+// the end of the storage, so files written next are laid out contiguously
+// as long as no metadata pair needs a new block in between. lfs_mount
+// starts at a pseudo-random block to spread wear instead.
+//
+// Returns a negative error code on failure.
+int lfs_fs_allocseek(lfs_t *lfs, lfs_block_t block);
+#endif
+
 #ifndef LFS_READONLY
 #ifdef LFS_MIGRATE
 // Attempts to migrate a previous version of littlefs